@@ -0,0 +1,201 @@
+#include <memory>
+#include <vector>
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QTextStream>
+
+#include "batchassembler.h"
+#include "hackassembler/code.h"
+#include "hackassembler/streamingassembler.h"
+
+const int BatchAssembler::MAX_REPORTED_ERRORS = 100;
+
+BatchAssembler::BatchAssembler(int threadCount)
+    : m_pool(threadCount),
+      m_streaming(false)
+{
+}
+
+/**
+  * Expands directories into the .asm files they contain (recursively) and
+  * keeps plain file arguments as they are.
+  */
+QStringList BatchAssembler::findSourceFiles(const QStringList& paths, QStringList *relativePaths)
+{
+    QStringList sourceFiles;
+    for (const QString& path : paths) {
+        QFileInfo pathInfo(path);
+        if (!pathInfo.isDir()) {
+            sourceFiles << path;
+            if (relativePaths)
+                *relativePaths << pathInfo.fileName();
+            continue;
+        }
+        QStringList directoryFiles;
+        QDirIterator it(path, QStringList() << "*.asm", QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext())
+            directoryFiles << it.next();
+        directoryFiles.sort();
+        sourceFiles << directoryFiles;
+        if (relativePaths) {
+            const QDir directory(path);
+            for (const QString& file : directoryFiles)
+                *relativePaths << directory.relativeFilePath(file);
+        }
+    }
+    return sourceFiles;
+}
+
+/**
+  * The output paths are worked out, and their directories made, before any
+  * file is assembled. A source whose .hack file would be the same as an
+  * earlier one's fails instead of overwriting it from another thread.
+  */
+BatchAssembler::ResultList BatchAssembler::assemble(const QStringList& sourcePaths, const QStringList& relativePaths) const
+{
+    ResultList results(sourcePaths.size());
+    QStringList binaryPaths;
+    QHash<QString, int> binaryPathSources;
+    for (int i = 0; i < sourcePaths.size(); i++) {
+        const QString& sourcePath = sourcePaths.at(i);
+        const QString relativePath = i < relativePaths.size() ? relativePaths.at(i) : QFileInfo(sourcePath).fileName();
+        const QString binaryPath = binaryPathForSource(sourcePath, relativePath);
+        binaryPaths << binaryPath;
+
+        const QString key = QDir::cleanPath(QFileInfo(binaryPath).absoluteFilePath());
+        if (binaryPathSources.contains(key)) {
+            Result& result = results[i];
+            result.sourcePath = sourcePath;
+            result.lineCount = 0;
+            result.instructionCount = 0;
+            result.errorCount = 0;
+            result.ioError = QString("%1 is also the output of %2")
+                             .arg(binaryPath).arg(sourcePaths.at(binaryPathSources.value(key)));
+            continue;
+        }
+        binaryPathSources.insert(key, i);
+        if (!m_outputDirectory.isEmpty())
+            QDir().mkpath(QFileInfo(binaryPath).path());
+    }
+
+    // Workers write to distinct slots, so take the pointer once to avoid
+    // detaching the vector from several threads.
+    Result *resultSlots = results.data();
+    // With fewer files than threads the spare threads go into each file,
+    // through a pool of its own, as a pool runs one batch at a time. A pool
+    // of one thread is shared.
+    const int fileThreadCount = qMax(1, m_pool.threadCount() / qMax(1, sourcePaths.size()));
+    const WorkStealingPool serialPool(1);
+    std::vector<std::unique_ptr<WorkStealingPool> > filePools;
+    if (fileThreadCount > 1 && !m_streaming) {
+        for (int i = 0; i < sourcePaths.size(); i++)
+            filePools.emplace_back(new WorkStealingPool(fileThreadCount));
+    }
+    m_pool.run(sourcePaths.size(), [this, &sourcePaths, &binaryPaths, &serialPool, &filePools, resultSlots](int i) {
+        if (!resultSlots[i].ioError.isEmpty())
+            return;
+        if (m_streaming)
+            resultSlots[i] = streamFile(sourcePaths.at(i), binaryPaths.at(i));
+        else
+            resultSlots[i] = assembleFile(sourcePaths.at(i), binaryPaths.at(i),
+                                          filePools.empty() ? serialPool : *filePools[i]);
+    });
+    return results;
+}
+
+BatchAssembler::Result BatchAssembler::assembleFile(const QString& sourcePath, const QString& binaryPath,
+                                                    const WorkStealingPool& pool) const
+{
+    Result result;
+    result.sourcePath = sourcePath;
+    result.lineCount = 0;
+    result.instructionCount = 0;
+    result.errorCount = 0;
+
+    QFile sourceFile(sourcePath);
+    if (!sourceFile.open(QFile::ReadOnly | QFile::Text)) {
+        result.ioError = sourceFile.errorString();
+        return result;
+    }
+    QTextStream sourceStream(&sourceFile);
+
+    Assembler assembler;
+    assembler.setSourceCode(sourceStream.readAll());
+    assembler.parse(pool);
+    result.lineCount = assembler.asmSrcCode().lineCount();
+    const Assembler::ErrorList& errors = assembler.errors();
+    result.errorCount = errors.size();
+    if (!errors.isEmpty()) {
+        const int reportedCount = qMin(errors.size(), MAX_REPORTED_ERRORS);
+        for (int i = 0; i < reportedCount; i++) {
+            const Assembler::Error& error = errors.at(i);
+            result.errorMessages << QString("%1: %2").arg(error.line + 1).arg(assembler.errorMessage(error));
+        }
+        return result;
+    }
+
+    assembler.translateAll(pool);
+    result.instructionCount = assembler.binaryCode().size();
+
+    QByteArray binary = Code::hackFileContents(assembler.binaryCode());
+
+    result.binaryPath = binaryPath;
+    QFile binaryFile(result.binaryPath);
+    if (!binaryFile.open(QFile::WriteOnly | QFile::Truncate) || binaryFile.write(binary) != binary.size())
+        result.ioError = binaryFile.errorString();
+    return result;
+}
+
+/**
+  * The .hack file is written while the source is read. It is removed again
+  * if the source turns out to have errors.
+  */
+BatchAssembler::Result BatchAssembler::streamFile(const QString& sourcePath, const QString& binaryPath) const
+{
+    Result result;
+    result.sourcePath = sourcePath;
+    result.lineCount = 0;
+    result.instructionCount = 0;
+    result.errorCount = 0;
+
+    QFile sourceFile(sourcePath);
+    if (!sourceFile.open(QFile::ReadOnly | QFile::Text)) {
+        result.ioError = sourceFile.errorString();
+        return result;
+    }
+    QFile binaryFile(binaryPath);
+    if (!binaryFile.open(QFile::ReadWrite | QFile::Truncate)) {
+        result.ioError = binaryFile.errorString();
+        return result;
+    }
+
+    StreamingAssembler assembler;
+    bool succeeded = assembler.assemble(&sourceFile, &binaryFile);
+    result.lineCount = assembler.lineCount();
+    result.instructionCount = assembler.instructionCount();
+    result.errorCount = assembler.errorCount();
+    result.errorMessages = assembler.errorMessages();
+    result.ioError = assembler.ioError();
+    if (!succeeded) {
+        binaryFile.remove();
+        return result;
+    }
+    result.binaryPath = binaryFile.fileName();
+    return result;
+}
+
+QString BatchAssembler::binaryPathForSource(const QString& sourcePath, const QString& relativePath) const
+{
+    QFileInfo sourceInfo(sourcePath);
+    QString binaryName = sourceInfo.completeBaseName() + ".hack";
+    if (m_outputDirectory.isEmpty())
+        return sourceInfo.dir().filePath(binaryName);
+    const QString relativeDirectory = QFileInfo(relativePath).path();
+    if (relativeDirectory != ".")
+        binaryName = relativeDirectory + '/' + binaryName;
+    return QDir(m_outputDirectory).filePath(binaryName);
+}
@@ -0,0 +1,61 @@
+#ifndef BATCHASSEMBLER_H
+#define BATCHASSEMBLER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "hackassembler/assembler.h"
+#include "hackassembler/workstealingpool.h"
+
+class BatchAssembler
+{
+public:
+    struct Result {
+        QString sourcePath;
+        QString binaryPath;
+        qint64 lineCount;
+        qint64 instructionCount;
+        qint64 errorCount;
+        // "line: message" for the first MAX_REPORTED_ERRORS errors.
+        QStringList errorMessages;
+        QString ioError;
+
+        bool succeeded() const { return errorCount == 0 && ioError.isEmpty(); }
+    };
+    typedef QVector<Result> ResultList;
+
+    static const int MAX_REPORTED_ERRORS;
+
+    explicit BatchAssembler(int threadCount = 0);
+
+    int threadCount() const { return m_pool.threadCount(); }
+
+    // Empty means each .hack file is written next to its source. Otherwise
+    // it goes to the source's relative path under the output directory.
+    void setOutputDirectory(const QString& outputDirectory) { m_outputDirectory = outputDirectory; }
+
+    // Assemble with StreamingAssembler, which never holds a whole file in
+    // memory, instead of the two-pass Assembler.
+    void setStreaming(bool streaming) { m_streaming = streaming; }
+    bool isStreaming() const { return m_streaming; }
+
+    // relativePaths, as from findSourceFiles(), default to the file names.
+    // Sources that would write the same .hack file are not assembled.
+    ResultList assemble(const QStringList& sourcePaths, const QStringList& relativePaths = QStringList()) const;
+
+    // relativePaths receives each file's path under the directory argument
+    // it was found in, or its file name for file arguments.
+    static QStringList findSourceFiles(const QStringList& paths, QStringList *relativePaths = NULL);
+
+private:
+    Result assembleFile(const QString& sourcePath, const QString& binaryPath, const WorkStealingPool& pool) const;
+    Result streamFile(const QString& sourcePath, const QString& binaryPath) const;
+    QString binaryPathForSource(const QString& sourcePath, const QString& relativePath) const;
+
+    WorkStealingPool m_pool;
+    QString m_outputDirectory;
+    bool m_streaming;
+};
+
+#endif // BATCHASSEMBLER_H
@@ -0,0 +1,29 @@
+#-------------------------------------------------
+#
+# hackasm: headless command-line Hack assembler.
+#
+#-------------------------------------------------
+
+QT += core
+QT -= gui
+
+QMAKE_CXXFLAGS += -std=c++14
+QMAKE_CXXFLAGS += -std=gnu++14
+
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = hackasm
+TEMPLATE = app
+
+include(../hackassembler/hackassembler.pri)
+
+SOURCES += main.cpp \
+    batchassembler.cpp \
+    malloccounter.cpp \
+    regexpparser.cpp
+
+HEADERS += \
+    batchassembler.h \
+    malloccounter.h \
+    regexpparser.h
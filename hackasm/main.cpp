@@ -0,0 +1,249 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+
+#include "batchassembler.h"
+#include "malloccounter.h"
+#include "hackassembler/assembler.h"
+#include "hackassembler/parser.h"
+#include "hackassembler/workstealingpool.h"
+#include "regexpparser.h"
+
+static const int BENCHMARK_EDITS = 100;
+
+/**
+  * Runs only the parser over the sources, on one thread, and reports its
+  * throughput next to that of the QRegExp parser it replaced, which is
+  * given the lines already split as it used to be. Then does the same for
+  * whole assemblies and for edits of single lines, made on all cores like
+  * the editor makes them, and reports how many heap allocations the process
+  * made for them.
+  * Reading and splitting the files is not measured.
+  */
+static int runParserBenchmark(const QStringList& sourceFiles, int passes, QTextStream& out, QTextStream& err)
+{
+    QVector<SourceText> sources;
+    qint64 lineCount = 0;
+    qint64 charCount = 0;
+    for (const QString& sourcePath : sourceFiles) {
+        QFile sourceFile(sourcePath);
+        if (!sourceFile.open(QFile::ReadOnly | QFile::Text)) {
+            err << sourcePath << ": " << sourceFile.errorString() << endl;
+            return 1;
+        }
+        sources << SourceText(QTextStream(&sourceFile).readAll());
+        lineCount += sources.last().lineCount();
+        charCount += sources.last().text().size();
+    }
+
+    qint64 commandCount = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int pass = 0; pass < passes; pass++) {
+        for (const SourceText& source : sources) {
+            Parser parser;
+            parser.setAsmSource(source);
+            while (parser.hasMoreLines()) {
+                parser.advance();
+                if (parser.commandType() != Lexer::NO_COMMAND)
+                    commandCount++;
+            }
+        }
+    }
+    double seconds = qMax(timer.nsecsElapsed(), qint64(1)) / 1e9;
+
+    out << QString("Parsed %1 lines (%2 MB, %3 commands) %4 times in %5 ms\n")
+           .arg(lineCount).arg(charCount / 1e6, 0, 'f', 1)
+           .arg(commandCount / passes).arg(passes).arg(seconds * 1e3, 0, 'f', 1);
+    out << QString("%1 lines/s, %2 MB/s\n")
+           .arg(lineCount * passes / seconds, 0, 'f', 0)
+           .arg(charCount * passes / seconds / 1e6, 0, 'f', 1);
+
+    QVector<QStringList> sourceLines;
+    for (const SourceText& source : sources)
+        sourceLines << source.text().split(QRegExp("\n|\r\n|\r"));
+    timer.restart();
+    for (int pass = 0; pass < passes; pass++) {
+        for (const QStringList& lines : sourceLines) {
+            RegExpParser parser;
+            parser.setAsmSource(lines);
+            while (parser.hasMoreLines())
+                parser.advance();
+        }
+    }
+    const double baselineSeconds = qMax(timer.nsecsElapsed(), qint64(1)) / 1e9;
+
+    out << QString("QRegExp parser: %1 lines/s, %2 MB/s, %3 times slower\n")
+           .arg(lineCount * passes / baselineSeconds, 0, 'f', 0)
+           .arg(charCount * passes / baselineSeconds / 1e6, 0, 'f', 1)
+           .arg(baselineSeconds / seconds, 0, 'f', 1);
+
+    // Re-assembling with the same Assembler and pool, like the editor's
+    // worker does, should only allocate on the first pass, while its
+    // buffers grow and the pool starts its threads.
+    WorkStealingPool pool;
+    Assembler assembler;
+    qint64 firstPassAllocations = 0;
+    qint64 allocationsBefore = MallocCounter::count();
+    timer.restart();
+    for (int pass = 0; pass < passes; pass++) {
+        for (const SourceText& source : sources) {
+            assembler.setSourceCode(source.text());
+            assembler.translateAll(pool);
+        }
+        if (pass == 0)
+            firstPassAllocations = MallocCounter::count() - allocationsBefore;
+    }
+    seconds = qMax(timer.nsecsElapsed(), qint64(1)) / 1e9;
+    const qint64 laterAllocations = MallocCounter::count() - allocationsBefore - firstPassAllocations;
+
+    out << QString("Assembled %1 times in %2 ms, %3 lines/s\n")
+           .arg(passes).arg(seconds * 1e3, 0, 'f', 1)
+           .arg(lineCount * passes / seconds, 0, 'f', 0);
+    if (MallocCounter::isAvailable()) {
+        out << QString("%1 heap allocations on the first pass, %2 per line on later passes\n")
+               .arg(firstPassAllocations)
+               .arg(passes > 1 ? double(laterAllocations) / (lineCount * (passes - 1)) : 0.0, 0, 'g', 3);
+    }
+
+    // Then the editor's path: every edit replaces one line, here with
+    // itself, and translates the whole source again. The list of edited
+    // lines is the caller's, and is made before each pass.
+    qint64 editCount = 0;
+    qint64 firstEditPassAllocations = 0;
+    qint64 laterEditAllocations = 0;
+    qint64 editNanoseconds = 0;
+    for (const SourceText& source : sources) {
+        assembler.setSourceCode(source.text());
+        assembler.translateAll(pool);
+        const int edits = qMin(BENCHMARK_EDITS, source.lineCount());
+        QVector<int> editedLineNumbers(edits);
+        QVector<QStringList> editedLines(edits);
+        for (int edit = 0; edit < edits; edit++) {
+            editedLineNumbers[edit] = int(qint64(source.lineCount()) * edit / edits);
+            editedLines[edit] << source.line(editedLineNumbers.at(edit)).toString();
+        }
+
+        for (int pass = 0; pass < passes; pass++) {
+            allocationsBefore = MallocCounter::count();
+            timer.restart();
+            for (int edit = 0; edit < edits; edit++) {
+                assembler.replaceSourceLines(editedLineNumbers.at(edit), 1, editedLines.at(edit));
+                assembler.translateAll(pool);
+            }
+            editNanoseconds += timer.nsecsElapsed();
+            const qint64 allocations = MallocCounter::count() - allocationsBefore;
+            if (pass == 0)
+                firstEditPassAllocations += allocations;
+            else
+                laterEditAllocations += allocations;
+        }
+        editCount += edits;
+    }
+
+    out << QString("Edited and re-assembled %1 single lines %2 times, %3 ms per edit\n")
+           .arg(editCount).arg(passes)
+           .arg(editCount > 0 ? editNanoseconds / 1e6 / (editCount * passes) : 0.0, 0, 'f', 3);
+    if (MallocCounter::isAvailable()) {
+        out << QString("%1 heap allocations on the first pass, %2 per edit on later passes\n")
+               .arg(firstEditPassAllocations)
+               .arg(passes > 1 && editCount > 0 ? double(laterEditAllocations) / (editCount * (passes - 1)) : 0.0,
+                    0, 'g', 3);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("github.com/setanta");
+    QCoreApplication::setApplicationName("hackasm");
+
+    QCommandLineParser cmdLine;
+    cmdLine.setApplicationDescription("Translates Hack assembly (.asm) files into Hack binary (.hack) files.");
+    cmdLine.addHelpOption();
+    cmdLine.addPositionalArgument("sources", "Hack assembly files, or directories to search for them.",
+                                  "<source>...");
+
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs",
+                                  "Number of worker threads (default: one per core).", "count", "0");
+    QCommandLineOption outputOption(QStringList() << "o" << "output-dir",
+                                    "Write .hack files to <dir> instead of next to their sources.", "dir");
+    QCommandLineOption quietOption(QStringList() << "q" << "quiet",
+                                   "Do not print the throughput summary.");
+    QCommandLineOption streamOption(QStringList() << "s" << "stream",
+                                    "Assemble each file in a single streaming pass, without loading it into memory.");
+    QCommandLineOption benchmarkOption(QStringList() << "b" << "benchmark",
+                                       "Only parse and assemble the sources, <passes> times, and report throughput and allocations.",
+                                       "passes");
+    cmdLine.addOption(jobsOption);
+    cmdLine.addOption(outputOption);
+    cmdLine.addOption(quietOption);
+    cmdLine.addOption(streamOption);
+    cmdLine.addOption(benchmarkOption);
+    cmdLine.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QStringList relativePaths;
+    QStringList sourceFiles = BatchAssembler::findSourceFiles(cmdLine.positionalArguments(), &relativePaths);
+    if (sourceFiles.isEmpty()) {
+        err << "hackasm: no input files" << endl;
+        return 2;
+    }
+
+    if (cmdLine.isSet(benchmarkOption))
+        return runParserBenchmark(sourceFiles, qMax(1, cmdLine.value(benchmarkOption).toInt()), out, err);
+
+    BatchAssembler batch(cmdLine.value(jobsOption).toInt());
+    if (cmdLine.isSet(outputOption)) {
+        QString outputDirectory = cmdLine.value(outputOption);
+        if (!QDir().mkpath(outputDirectory)) {
+            err << "hackasm: cannot create output directory " << outputDirectory << endl;
+            return 2;
+        }
+        batch.setOutputDirectory(outputDirectory);
+    }
+    batch.setStreaming(cmdLine.isSet(streamOption));
+
+    QElapsedTimer timer;
+    timer.start();
+    const BatchAssembler::ResultList results = batch.assemble(sourceFiles, relativePaths);
+    qint64 elapsed = timer.nsecsElapsed();
+
+    int failedFiles = 0;
+    qint64 totalLines = 0;
+    qint64 totalInstructions = 0;
+    for (const BatchAssembler::Result& result : results) {
+        totalLines += result.lineCount;
+        totalInstructions += result.instructionCount;
+        if (result.succeeded())
+            continue;
+
+        failedFiles++;
+        if (!result.ioError.isEmpty())
+            err << result.sourcePath << ": " << result.ioError << endl;
+        for (const QString& message : result.errorMessages)
+            err << result.sourcePath << ":" << message << endl;
+        if (result.errorCount > result.errorMessages.size())
+            err << result.sourcePath << ": " << result.errorCount - result.errorMessages.size()
+                << " more errors" << endl;
+    }
+
+    if (!cmdLine.isSet(quietOption)) {
+        double seconds = qMax(elapsed, qint64(1)) / 1e9;
+        out << QString("Assembled %1 of %2 files (%3 lines, %4 instructions) in %5 ms on %6 threads\n")
+               .arg(results.size() - failedFiles).arg(results.size())
+               .arg(totalLines).arg(totalInstructions)
+               .arg(seconds * 1e3, 0, 'f', 1).arg(batch.threadCount());
+        out << QString("%1 files/s, %2 lines/s\n")
+               .arg(results.size() / seconds, 0, 'f', 0)
+               .arg(totalLines / seconds, 0, 'f', 0);
+    }
+
+    return failedFiles == 0 ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+#include <atomic>
+#include <stdlib.h>
+
+#include "malloccounter.h"
+
+#if defined(__GLIBC__)
+
+namespace {
+
+// Constant-initialized, so it is ready before the first allocation of the
+// program, static constructors included.
+std::atomic<qint64> mallocCount(0);
+
+} // namespace
+
+/**
+  * These replace the C library's functions for the whole process, shared
+  * libraries included, and forward to its implementations, which glibc
+  * exports under these names for this very purpose. free() goes straight to
+  * the C library's and is not replaced.
+  */
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size) noexcept
+{
+    mallocCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) noexcept
+{
+    mallocCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) noexcept
+{
+    mallocCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+} // extern "C"
+
+bool MallocCounter::isAvailable()
+{
+    return true;
+}
+
+qint64 MallocCounter::count()
+{
+    return mallocCount.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool MallocCounter::isAvailable()
+{
+    return false;
+}
+
+qint64 MallocCounter::count()
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef MALLOCCOUNTER_H
+#define MALLOCCOUNTER_H
+
+#include <QtGlobal>
+
+// Counts the heap allocations of the whole process: malloc() and friends
+// are replaced by versions that count each call and then forward to the C
+// library, so operator new and Qt's containers are counted too. Only
+// available with glibc, which exports the functions to forward to.
+class MallocCounter
+{
+public:
+    static bool isAvailable();
+    // Calls to malloc(), calloc() and realloc(), from every thread, since
+    // the program started.
+    static qint64 count();
+};
+
+#endif // MALLOCCOUNTER_H
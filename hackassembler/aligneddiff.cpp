@@ -0,0 +1,377 @@
+#include <climits>
+#include <algorithm>
+#include <vector>
+
+#include "aligneddiff.h"
+
+namespace {
+
+// Below this many edits, the search for a middle snake is never cut short.
+const int MIN_COST_LIMIT = 256;
+
+/**
+ * Myers' O(ND) difference algorithm in linear space, after the divide and
+ * conquer variant in GNU diff: the middle snake of a shortest edit script
+ * splits the problem in two, and the search for it is cut short on
+ * expensive stretches, which gives up a minimal script there for bounded
+ * time. It marks the lines that are not part of the common subsequence.
+ */
+template <typename Word>
+class EditScript
+{
+public:
+    EditScript(const Word *left, int leftCount, const Word *right, int rightCount)
+        : m_left(left),
+          m_right(right),
+          m_leftChanged(size_t(leftCount), false),
+          m_rightChanged(size_t(rightCount), false),
+          m_forward(size_t(leftCount) + size_t(rightCount) + 3),
+          m_backward(size_t(leftCount) + size_t(rightCount) + 3),
+          m_diagonalOffset(rightCount + 1),
+          m_costLimit(MIN_COST_LIMIT)
+    {
+        int bits = 0;
+        for (qint64 size = qint64(leftCount) + rightCount + 3; size > 0; size >>= 1)
+            bits++;
+        m_costLimit = qMax(MIN_COST_LIMIT, 1 << (bits / 2));
+        compareSequences(0, leftCount, 0, rightCount);
+    }
+
+    const std::vector<bool>& leftChanged() const { return m_leftChanged; }
+    const std::vector<bool>& rightChanged() const { return m_rightChanged; }
+
+private:
+    int& forward(int diagonal) { return m_forward[size_t(diagonal + m_diagonalOffset)]; }
+    int& backward(int diagonal) { return m_backward[size_t(diagonal + m_diagonalOffset)]; }
+
+    void compareSequences(int leftBegin, int leftEnd, int rightBegin, int rightEnd);
+    void middleSnake(int leftBegin, int leftEnd, int rightBegin, int rightEnd, int *leftSplit, int *rightSplit);
+
+    const Word *m_left;
+    const Word *m_right;
+    std::vector<bool> m_leftChanged;
+    std::vector<bool> m_rightChanged;
+    // Furthest reaching x per diagonal x - y, searching forward and backward.
+    std::vector<int> m_forward;
+    std::vector<int> m_backward;
+    int m_diagonalOffset;
+    int m_costLimit;
+};
+
+/**
+ * Common lines at either end are matched off first, which is all there is
+ * to do for most of a program that mostly matches.
+ */
+template <typename Word>
+void EditScript<Word>::compareSequences(int leftBegin, int leftEnd, int rightBegin, int rightEnd)
+{
+    while (leftBegin < leftEnd && rightBegin < rightEnd && m_left[leftBegin] == m_right[rightBegin]) {
+        leftBegin++;
+        rightBegin++;
+    }
+    while (leftEnd > leftBegin && rightEnd > rightBegin && m_left[leftEnd - 1] == m_right[rightEnd - 1]) {
+        leftEnd--;
+        rightEnd--;
+    }
+
+    if (leftBegin == leftEnd) {
+        std::fill(m_rightChanged.begin() + rightBegin, m_rightChanged.begin() + rightEnd, true);
+    } else if (rightBegin == rightEnd) {
+        std::fill(m_leftChanged.begin() + leftBegin, m_leftChanged.begin() + leftEnd, true);
+    } else {
+        int leftSplit;
+        int rightSplit;
+        middleSnake(leftBegin, leftEnd, rightBegin, rightEnd, &leftSplit, &rightSplit);
+        compareSequences(leftBegin, leftSplit, rightBegin, rightSplit);
+        compareSequences(leftSplit, leftEnd, rightSplit, rightEnd);
+    }
+}
+
+/**
+ * Searches forward from the start and backward from the end, one edit at a
+ * time on each side, until the paths overlap on a diagonal. Once the cost
+ * limit is reached, the split is taken at the point either search got
+ * furthest to instead.
+ */
+template <typename Word>
+void EditScript<Word>::middleSnake(int leftBegin, int leftEnd, int rightBegin, int rightEnd,
+                                   int *leftSplit, int *rightSplit)
+{
+    const int minDiagonal = leftBegin - rightEnd;
+    const int maxDiagonal = leftEnd - rightBegin;
+    const int forwardMid = leftBegin - rightBegin;
+    const int backwardMid = leftEnd - rightEnd;
+    int forwardMin = forwardMid;
+    int forwardMax = forwardMid;
+    int backwardMin = backwardMid;
+    int backwardMax = backwardMid;
+    const bool odd = (forwardMid - backwardMid) & 1;
+
+    forward(forwardMid) = leftBegin;
+    backward(backwardMid) = leftEnd;
+
+    for (int cost = 1;; cost++) {
+        if (forwardMin > minDiagonal)
+            forward(--forwardMin - 1) = -1;
+        else
+            forwardMin++;
+        if (forwardMax < maxDiagonal)
+            forward(++forwardMax + 1) = -1;
+        else
+            forwardMax--;
+        for (int diagonal = forwardMax; diagonal >= forwardMin; diagonal -= 2) {
+            const int low = forward(diagonal - 1);
+            const int high = forward(diagonal + 1);
+            int x = low >= high ? low + 1 : high;
+            int y = x - diagonal;
+            while (x < leftEnd && y < rightEnd && m_left[x] == m_right[y]) {
+                x++;
+                y++;
+            }
+            forward(diagonal) = x;
+            if (odd && backwardMin <= diagonal && diagonal <= backwardMax && backward(diagonal) <= x) {
+                *leftSplit = x;
+                *rightSplit = y;
+                return;
+            }
+        }
+
+        if (backwardMin > minDiagonal)
+            backward(--backwardMin - 1) = INT_MAX;
+        else
+            backwardMin++;
+        if (backwardMax < maxDiagonal)
+            backward(++backwardMax + 1) = INT_MAX;
+        else
+            backwardMax--;
+        for (int diagonal = backwardMax; diagonal >= backwardMin; diagonal -= 2) {
+            const int low = backward(diagonal - 1);
+            const int high = backward(diagonal + 1);
+            int x = low < high ? low : high - 1;
+            int y = x - diagonal;
+            while (x > leftBegin && y > rightBegin && m_left[x - 1] == m_right[y - 1]) {
+                x--;
+                y--;
+            }
+            backward(diagonal) = x;
+            if (!odd && forwardMin <= diagonal && diagonal <= forwardMax && x <= forward(diagonal)) {
+                *leftSplit = x;
+                *rightSplit = y;
+                return;
+            }
+        }
+
+        if (cost < m_costLimit)
+            continue;
+
+        int forwardBestSum = -1;
+        int forwardBestX = leftBegin;
+        for (int diagonal = forwardMax; diagonal >= forwardMin; diagonal -= 2) {
+            int x = qMin(forward(diagonal), leftEnd);
+            int y = x - diagonal;
+            if (y > rightEnd) {
+                x = rightEnd + diagonal;
+                y = rightEnd;
+            }
+            if (x + y > forwardBestSum) {
+                forwardBestSum = x + y;
+                forwardBestX = x;
+            }
+        }
+        int backwardBestSum = INT_MAX;
+        int backwardBestX = leftEnd;
+        for (int diagonal = backwardMax; diagonal >= backwardMin; diagonal -= 2) {
+            int x = qMax(leftBegin, backward(diagonal));
+            int y = x - diagonal;
+            if (y < rightBegin) {
+                x = rightBegin + diagonal;
+                y = rightBegin;
+            }
+            if (x + y < backwardBestSum) {
+                backwardBestSum = x + y;
+                backwardBestX = x;
+            }
+        }
+        if ((leftEnd + rightEnd) - backwardBestSum < forwardBestSum - (leftBegin + rightBegin)) {
+            *leftSplit = forwardBestX;
+            *rightSplit = forwardBestSum - forwardBestX;
+        } else {
+            *leftSplit = backwardBestX;
+            *rightSplit = backwardBestSum - backwardBestX;
+        }
+        return;
+    }
+}
+
+} // namespace
+
+AlignedDiff::AlignedDiff()
+    : m_rowCount(0),
+      m_mismatchCount(0)
+{
+}
+
+/**
+ * Lines that never match are given values outside the 16-bit range, unique
+ * to each, which takes a widened copy of both programs.
+ */
+void AlignedDiff::compare(const quint16 *left, int leftCount, const quint16 *right, int rightCount,
+                          const QVector<int>& rightNeverEqual)
+{
+    if (rightNeverEqual.isEmpty()) {
+        EditScript<quint16> script(left, leftCount, right, rightCount);
+        addSegments(script.leftChanged(), script.rightChanged());
+        return;
+    }
+
+    std::vector<quint32> wideLeft(left, left + leftCount);
+    std::vector<quint32> wideRight(right, right + rightCount);
+    for (int line : rightNeverEqual)
+        wideRight[size_t(line)] = 0x10000u + quint32(line);
+    EditScript<quint32> script(wideLeft.data(), leftCount, wideRight.data(), rightCount);
+    addSegments(script.leftChanged(), script.rightChanged());
+}
+
+/**
+ * Pairs up the lines outside the edit script in order; between two such
+ * stretches lies one change, with the changed lines of both sides.
+ */
+void AlignedDiff::addSegments(const std::vector<bool>& leftChanged, const std::vector<bool>& rightChanged)
+{
+    clear();
+    const int leftCount = int(leftChanged.size());
+    const int rightCount = int(rightChanged.size());
+
+    int leftLine = 0;
+    int rightLine = 0;
+    while (leftLine < leftCount || rightLine < rightCount) {
+        int leftEnd = leftLine;
+        int rightEnd = rightLine;
+        if (leftLine < leftCount && rightLine < rightCount
+                && !leftChanged[size_t(leftLine)] && !rightChanged[size_t(rightLine)]) {
+            while (leftEnd < leftCount && rightEnd < rightCount
+                   && !leftChanged[size_t(leftEnd)] && !rightChanged[size_t(rightEnd)]) {
+                leftEnd++;
+                rightEnd++;
+            }
+            addSegment(leftLine, rightLine, leftEnd - leftLine, rightEnd - rightLine, true);
+        } else {
+            while (leftEnd < leftCount && leftChanged[size_t(leftEnd)])
+                leftEnd++;
+            while (rightEnd < rightCount && rightChanged[size_t(rightEnd)])
+                rightEnd++;
+            addSegment(leftLine, rightLine, leftEnd - leftLine, rightEnd - rightLine, false);
+        }
+        leftLine = leftEnd;
+        rightLine = rightEnd;
+    }
+}
+
+void AlignedDiff::clear()
+{
+    m_segments.clear();
+    m_rowCount = 0;
+    m_mismatchCount = 0;
+}
+
+int AlignedDiff::leftLine(int row) const
+{
+    const Segment& segment = m_segments.at(segmentForRow(row));
+    const int offset = row - segment.row;
+    return offset < segment.leftCount ? segment.leftFirst + offset : -1;
+}
+
+int AlignedDiff::rightLine(int row) const
+{
+    const Segment& segment = m_segments.at(segmentForRow(row));
+    const int offset = row - segment.row;
+    return offset < segment.rightCount ? segment.rightFirst + offset : -1;
+}
+
+int AlignedDiff::rowForLeftLine(int line) const
+{
+    const int index = segmentForLine(line, &Segment::leftFirst, &Segment::leftCount);
+    return index < 0 ? -1 : m_segments.at(index).row + line - m_segments.at(index).leftFirst;
+}
+
+int AlignedDiff::rowForRightLine(int line) const
+{
+    const int index = segmentForLine(line, &Segment::rightFirst, &Segment::rightCount);
+    return index < 0 ? -1 : m_segments.at(index).row + line - m_segments.at(index).rightFirst;
+}
+
+int AlignedDiff::mismatchCountBefore(int row) const
+{
+    if (row >= m_rowCount)
+        return m_mismatchCount;
+    if (row <= 0)
+        return 0;
+    const Segment& segment = m_segments.at(segmentForRow(row));
+    return segment.mismatchesBefore + (segment.equal ? 0 : row - segment.row);
+}
+
+bool AlignedDiff::isMismatch(int row) const
+{
+    return !m_segments.at(segmentForRow(row)).equal;
+}
+
+/**
+ * Equal and changed segments alternate, so the next change is either the
+ * rest of the segment holding the next row or the segment after it.
+ */
+int AlignedDiff::nextMismatch(int row) const
+{
+    const int next = qMax(row + 1, 0);
+    if (next >= m_rowCount)
+        return -1;
+    const int index = segmentForRow(next);
+    if (!m_segments.at(index).equal)
+        return next;
+    return index + 1 < m_segments.size() ? m_segments.at(index + 1).row : -1;
+}
+
+int AlignedDiff::previousMismatch(int row) const
+{
+    const int previous = qMin(row - 1, m_rowCount - 1);
+    if (previous < 0)
+        return -1;
+    const int index = segmentForRow(previous);
+    if (!m_segments.at(index).equal)
+        return previous;
+    return index > 0 ? m_segments.at(index).row - 1 : -1;
+}
+
+int AlignedDiff::segmentForRow(int row) const
+{
+    Q_ASSERT(row >= 0 && row < m_rowCount);
+    QVector<Segment>::const_iterator segment = std::upper_bound(m_segments.constBegin(), m_segments.constEnd(), row,
+                                                                [](int row, const Segment& segment) { return row < segment.row; });
+    return int(segment - m_segments.constBegin()) - 1;
+}
+
+/**
+ * A segment without lines on this side starts where the next one does, so
+ * the segment found may have to give way to the one before it.
+ */
+int AlignedDiff::segmentForLine(int line, int Segment::*first, int Segment::*count) const
+{
+    QVector<Segment>::const_iterator segment = std::upper_bound(m_segments.constBegin(), m_segments.constEnd(), line,
+                                                                [first](int line, const Segment& segment) { return line < segment.*first; });
+    while (segment != m_segments.constBegin()) {
+        --segment;
+        if (line < (*segment).*first + (*segment).*count)
+            return int(segment - m_segments.constBegin());
+        if ((*segment).*count > 0)
+            break;
+    }
+    return -1;
+}
+
+void AlignedDiff::addSegment(int leftFirst, int rightFirst, int leftCount, int rightCount, bool equal)
+{
+    Segment segment = { m_rowCount, leftFirst, rightFirst, leftCount, rightCount, equal, m_mismatchCount };
+    m_segments.append(segment);
+    m_rowCount += segment.rowCount();
+    if (!equal)
+        m_mismatchCount += segment.rowCount();
+}
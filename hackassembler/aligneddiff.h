@@ -0,0 +1,62 @@
+#ifndef ALIGNEDDIFF_H
+#define ALIGNEDDIFF_H
+
+#include <QVector>
+#include <vector>
+
+// Alignment of two programs by their longest common subsequence of
+// instructions, so that an inserted or deleted instruction only shows up
+// where it is. The result is a list of rows, as a side-by-side view shows
+// them: equal lines are paired up, and within a changed stretch the lines
+// of both sides are paired in order, the shorter side padded with gaps.
+class AlignedDiff
+{
+public:
+    AlignedDiff();
+
+    // Lines in rightNeverEqual match no line.
+    void compare(const quint16 *left, int leftCount, const quint16 *right, int rightCount,
+                 const QVector<int>& rightNeverEqual = QVector<int>());
+    void clear();
+
+    int rowCount() const { return m_rowCount; }
+    int mismatchCount() const { return m_mismatchCount; }
+    // The rows before row that are part of a change.
+    int mismatchCountBefore(int row) const;
+
+    // The line shown on a row, or -1 for a gap.
+    int leftLine(int row) const;
+    int rightLine(int row) const;
+    int rowForLeftLine(int line) const;
+    int rowForRightLine(int line) const;
+
+    bool isMismatch(int row) const;
+    // The closest row after or before row that is part of a change, or -1.
+    int nextMismatch(int row) const;
+    int previousMismatch(int row) const;
+
+private:
+    struct Segment
+    {
+        int row;
+        int leftFirst;
+        int rightFirst;
+        int leftCount;
+        int rightCount;
+        bool equal;
+        int mismatchesBefore;
+
+        int rowCount() const { return qMax(leftCount, rightCount); }
+    };
+
+    int segmentForRow(int row) const;
+    int segmentForLine(int line, int Segment::*first, int Segment::*count) const;
+    void addSegments(const std::vector<bool>& leftChanged, const std::vector<bool>& rightChanged);
+    void addSegment(int leftFirst, int rightFirst, int leftCount, int rightCount, bool equal);
+
+    QVector<Segment> m_segments;
+    int m_rowCount;
+    int m_mismatchCount;
+};
+
+#endif // ALIGNEDDIFF_H
@@ -0,0 +1,71 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "arena.h"
+
+const int Arena::DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+Arena::Arena(int blockSize)
+    : m_currentBlock(0),
+      m_offset(0),
+      m_blockSize(size_t(blockSize))
+{
+}
+
+Arena::Arena(Arena&& other)
+    : m_blocks(std::move(other.m_blocks)),
+      m_currentBlock(other.m_currentBlock),
+      m_offset(other.m_offset),
+      m_blockSize(other.m_blockSize)
+{
+    other.m_blocks.clear();
+    other.m_currentBlock = 0;
+    other.m_offset = 0;
+}
+
+Arena::~Arena()
+{
+    for (const Block& block : m_blocks)
+        std::free(block.data);
+}
+
+/**
+ * Blocks kept from before a reset are reused in order; one that is too
+ * small for the allocation is skipped. Only past the last block is a new
+ * one taken from the heap, big enough for allocations larger than a block.
+ */
+void *Arena::allocate(size_t size, size_t alignment)
+{
+    for (; m_currentBlock < m_blocks.size(); m_currentBlock++, m_offset = 0) {
+        const Block& block = m_blocks[m_currentBlock];
+        const size_t offset = (m_offset + alignment - 1) & ~(alignment - 1);
+        if (offset + size <= block.size) {
+            m_offset = offset + size;
+            return block.data + offset;
+        }
+    }
+
+    Block block;
+    block.size = qMax(m_blockSize, size);
+    block.data = static_cast<char *>(std::malloc(block.size));
+    Q_CHECK_PTR(block.data);
+    m_blocks.push_back(block);
+    m_currentBlock = m_blocks.size() - 1;
+    m_offset = size;
+    return block.data;
+}
+
+QStringView Arena::copy(QStringView text)
+{
+    if (text.isEmpty())
+        return QStringView();
+    QChar *chars = allocate<QChar>(int(text.size()));
+    std::memcpy(chars, text.data(), size_t(text.size()) * sizeof(QChar));
+    return QStringView(chars, text.size());
+}
+
+void Arena::reset()
+{
+    m_currentBlock = 0;
+    m_offset = 0;
+}
@@ -0,0 +1,44 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <QStringView>
+#include <QtGlobal>
+#include <vector>
+
+// Monotonic allocator: allocations are carved one after the other out of
+// large blocks and are never freed one by one. reset() releases them all at
+// once and keeps the blocks, so data rebuilt the same way after a reset
+// needs no new heap allocations.
+class Arena
+{
+public:
+    static const int DEFAULT_BLOCK_SIZE;
+
+    explicit Arena(int blockSize = DEFAULT_BLOCK_SIZE);
+    Arena(Arena&& other);
+    ~Arena();
+
+    void *allocate(size_t size, size_t alignment);
+    template <typename T>
+    T *allocate(int count) { return static_cast<T *>(allocate(count * sizeof(T), alignof(T))); }
+    // A copy of text that lives until the next reset().
+    QStringView copy(QStringView text);
+
+    void reset();
+
+private:
+    Q_DISABLE_COPY(Arena)
+
+    struct Block
+    {
+        char *data;
+        size_t size;
+    };
+
+    std::vector<Block> m_blocks;
+    size_t m_currentBlock;
+    size_t m_offset;
+    size_t m_blockSize;
+};
+
+#endif // ARENA_H
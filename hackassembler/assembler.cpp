@@ -1,97 +1,395 @@
+#include <algorithm>
+#include <functional>
+#include <vector>
+
 #include "assembler.h"
-#include "code.h"
+#include "splice.h"
+
+Assembler::Assembler()
+    : m_nonBlankLineCount(0)
+{
+}
 
 void Assembler::setSourceCode(const QString& asmSource)
 {
-    m_parser.setAsmSource(asmSource.split(QRegExp("\n|\r\n|\r")));
+    m_asmSource.setText(asmSource);
     clearParsingData();
 }
 
+/**
+ * Replaces removedCount lines starting at firstLine with the given lines and
+ * re-parses only those. Falls back to a full parse() if the source has not
+ * been parsed yet.
+ */
+void Assembler::replaceSourceLines(int firstLine, int removedCount, const QStringList& lines)
+{
+    Q_ASSERT(firstLine >= 0 && removedCount >= 0 && firstLine + removedCount <= m_asmSource.lineCount());
+
+    const bool wasParsed = isParsed();
+    if (wasParsed) {
+        for (int line = firstLine; line < firstLine + removedCount; line++) {
+            if (!Lexer::isBlank(m_asmSource.line(line)))
+                m_nonBlankLineCount--;
+        }
+    }
+    m_asmSource.replaceLines(firstLine, removedCount, lines);
+
+    if (!wasParsed) {
+        parse();
+        return;
+    }
+    clearTranslationData();
+    parseLines(firstLine, removedCount, lines.size());
+}
+
 void Assembler::clearParsingData()
 {
     clearTranslationData();
     m_symbolTable.clear();
     m_errors.clear();
+    m_instructions.clear();
+    m_lineAddresses.clear();
+    m_labels.clear();
+    m_nonBlankLineCount = 0;
 }
 
 void Assembler::clearTranslationData()
 {
-    m_parser.reset();
+    m_symbolTable.clearVariables();
     m_binaryCode.clear();
-    m_srcToBinLines.clear();
-    m_binToSrcLines.clear();
 }
 
-int Assembler::sourceLineForBinaryLine(int binaryLineNumber)
+int Assembler::sourceLineForBinaryLine(int binaryLineNumber) const
 {
-    return m_binToSrcLines.value(binaryLineNumber, -1);
+    if (binaryLineNumber < 0 || binaryLineNumber >= m_binaryCode.size())
+        return -1;
+    return m_instructions.sourceLine(binaryLineNumber);
 }
 
-int Assembler::binaryLineForSourceLine(int sourceLineNumber)
+/**
+ * Lines without an instruction map to the next instruction. Returns -1 when
+ * that instruction has not been translated yet.
+ */
+int Assembler::binaryLineForSourceLine(int sourceLineNumber) const
 {
-    return m_srcToBinLines.value(sourceLineNumber, -1);
+    if (sourceLineNumber < 0 || sourceLineNumber >= m_lineAddresses.size())
+        return -1;
+    const int binaryLineNumber = m_lineAddresses.at(sourceLineNumber);
+    return binaryLineNumber < m_binaryCode.size() ? binaryLineNumber : -1;
 }
 
 void Assembler::parse()
 {
     clearParsingData();
-    uint memoryAddress = 0;
+    parseLines(0, 0, m_asmSource.lineCount());
+}
+
+int Assembler::addressOfLine(int line) const
+{
+    return line < m_lineAddresses.size() ? m_lineAddresses.at(line) : m_instructions.size();
+}
+
+/**
+ * Parses the addedCount source lines starting at firstLine, which replaced
+ * removedCount previously parsed lines, and splices the results in.
+ *
+ * Addresses and label values after the edit are shifted rather than
+ * recomputed. The label table is only rebuilt when the edit added, removed
+ * or moved a label definition.
+ */
+void Assembler::parseLines(int firstLine, int removedCount, int addedCount)
+{
+    const int oldEndLine = firstLine + removedCount;
+    const int lineDelta = addedCount - removedCount;
+    const int firstAddress = addressOfLine(firstLine);
+    const int oldAddressCount = addressOfLine(oldEndLine) - firstAddress;
 
-    while (m_parser.hasMoreLines()) {
-        m_parser.advance();
+    QVector<int>& lineAddresses = m_editLineAddresses;
+    ParsedRange& parsed = m_editRange;
+    lineAddresses.resize(addedCount);
+    parseRange(m_asmSource, firstLine, firstLine + addedCount, firstAddress,
+               lineAddresses.data(), m_symbolTable, parsed);
+    const QVector<Label>& labels = parsed.labels;
+    m_nonBlankLineCount += parsed.nonBlankLineCount;
+    const int addressDelta = (parsed.endAddress - firstAddress) - oldAddressCount;
 
-        switch (m_parser.commandType()) {
-        case Parser::A_COMMAND:
-        case Parser::C_COMMAND:
-            memoryAddress++;
+    // Labels defined by the replaced lines, compared before the addresses move.
+    auto byLine = [](const Label& label, int line) { return label.line < line; };
+    const int labelBegin = std::lower_bound(m_labels.constBegin(), m_labels.constEnd(), firstLine, byLine) - m_labels.constBegin();
+    const int labelEnd = std::lower_bound(m_labels.constBegin(), m_labels.constEnd(), oldEndLine, byLine) - m_labels.constBegin();
+    bool labelsChanged = labelEnd - labelBegin != labels.size();
+    for (int i = 0; !labelsChanged && i < labels.size(); i++) {
+        const Label& oldLabel = m_labels.at(labelBegin + i);
+        labelsChanged = oldLabel.symbolId != labels.at(i).symbolId ||
+                        m_lineAddresses.at(oldLabel.line) != lineAddresses.at(labels.at(i).line - firstLine);
+    }
+
+    m_instructions.replace(firstAddress, oldAddressCount, parsed.instructions, lineDelta);
+    splice(m_lineAddresses, firstLine, removedCount, lineAddresses);
+    if (addressDelta != 0) {
+        for (int line = firstLine + addedCount; line < m_lineAddresses.size(); line++)
+            m_lineAddresses[line] += addressDelta;
+    }
+
+    splice(m_labels, labelBegin, labelEnd - labelBegin, labels);
+    const int labelsAfterEdit = labelBegin + labels.size();
+    if (lineDelta != 0) {
+        for (int i = labelsAfterEdit; i < m_labels.size(); i++)
+            m_labels[i].line += lineDelta;
+    }
+
+    if (labelsChanged) {
+        rebuildLabelTable();
+    } else if (addressDelta != 0) {
+        for (int i = labelsAfterEdit; i < m_labels.size(); i++)
+            m_symbolTable.addLabel(m_labels.at(i).symbolId, m_lineAddresses.at(m_labels.at(i).line));
+    }
+
+    updateErrors(firstLine, removedCount, lineDelta, parsed.errors);
+}
+
+/**
+ * Lexes the source lines [firstLine, endLine) into the range, replacing what
+ * it held, with instructions numbered from firstAddress on, and interns
+ * their symbols into the given table. lineAddresses is indexed from firstLine. Only reads shared
+ * state otherwise, so ranges with tables of their own can be parsed
+ * concurrently.
+ */
+void Assembler::parseRange(const SourceText& source, int firstLine, int endLine, int firstAddress,
+                           int *lineAddresses, SymbolTable& symbols, ParsedRange& range)
+{
+    range.instructions.clear();
+    range.labels.clear();
+    range.errors.clear();
+    range.nonBlankLineCount = 0;
+    int address = firstAddress;
+    for (int line = firstLine; line < endLine; line++) {
+        const QStringView sourceLine = source.line(line);
+        const Lexer::Line parsed = Lexer::lex(sourceLine);
+        lineAddresses[line - firstLine] = address;
+
+        switch (parsed.commandType) {
+        case Lexer::A_COMMAND:
+            if (parsed.isConstant)
+                range.instructions.append(InstructionList::CONSTANT, parsed.code, -1, line);
+            else
+                range.instructions.append(InstructionList::SYMBOL, 0, symbols.intern(parsed.symbol), line);
+            address++;
             break;
 
-        case Parser::L_COMMAND:
-            m_symbolTable.addEntry(m_parser.symbol(), memoryAddress);
+        case Lexer::C_COMMAND:
+            range.instructions.append(InstructionList::COMPUTE, parsed.code, -1, line);
+            address++;
             break;
 
-        default:
+        case Lexer::L_COMMAND:
+            if (!parsed.hasError())
+                range.labels.append({ line, symbols.intern(parsed.symbol) });
             break;
+
+        default:
+            if (!Lexer::isBlank(sourceLine))
+                range.nonBlankLineCount++;
+            continue;
         }
 
-        if (m_parser.hasError())
-            m_errors.append({ m_parser.error(), m_parser.currentLine() });
+        range.nonBlankLineCount++;
+        if (parsed.hasError()) {
+            const int column = int(parsed.errorText.data() - sourceLine.data());
+            range.errors.append({ line, parsed.error, column, int(parsed.errorText.size()) });
+        }
     }
-    m_parser.reset();
+    range.endAddress = address;
 }
 
+/**
+ * Parallel version of parse() for large sources. The lines are split in
+ * chunks that are lexed concurrently, each into instructions of its own
+ * numbered from zero; a prefix sum over the chunk sizes then gives every
+ * chunk its first ROM address, and a second parallel sweep moves the
+ * chunks' instructions into place and adds that address to their line
+ * addresses. Each chunk interns its symbols into a table of its own; the
+ * merge maps those ids onto the shared table in chunk order, and the
+ * second sweep rewrites them. Labels and errors are merged in chunk order
+ * too, so the result is the same as a sequential parse.
+ *
+ * The tasks are handed to the pool by reference, since std::function would
+ * copy captures this large to the heap.
+ */
+void Assembler::parse(const WorkStealingPool& pool)
+{
+    clearParsingData();
+    const SourceText& source = m_asmSource;
+    const int lineCount = source.lineCount();
+    const int chunkCount = parallelChunkCount(lineCount, pool);
+
+    m_lineAddresses.resize(lineCount);
+    int *lineAddresses = m_lineAddresses.data();
+
+    // The per-chunk buffers only ever grow, so that sources of another size
+    // still find the memory of their chunks.
+    if (m_chunks.size() < chunkCount) {
+        m_chunks.resize(chunkCount);
+        m_chunkSymbols.resize(size_t(chunkCount));
+        m_chunkSymbolIds.resize(chunkCount);
+    }
+    ParsedRange *chunkData = m_chunks.data();
+    SymbolTable *chunkSymbolData = m_chunkSymbols.data();
+    auto parseChunk = [&source, lineCount, chunkCount, lineAddresses, chunkData, chunkSymbolData](int chunk) {
+        const int firstLine = chunkFirstLine(chunk, lineCount, chunkCount);
+        chunkSymbolData[chunk].clear();
+        parseRange(source, firstLine, chunkFirstLine(chunk + 1, lineCount, chunkCount), 0,
+                   lineAddresses + firstLine, chunkSymbolData[chunk], chunkData[chunk]);
+    };
+    pool.run(chunkCount, std::cref(parseChunk));
+
+    m_chunkAddresses.resize(chunkCount);
+    int instructionCount = 0;
+    for (int chunk = 0; chunk < chunkCount; chunk++) {
+        const SymbolTable& symbols = m_chunkSymbols.at(size_t(chunk));
+        QVector<int>& symbolIds = m_chunkSymbolIds[chunk];
+        symbolIds.resize(symbols.symbolCount());
+        for (int id = 0; id < symbols.symbolCount(); id++)
+            symbolIds[id] = m_symbolTable.intern(symbols.name(id));
+
+        m_chunkAddresses[chunk] = instructionCount;
+        instructionCount += m_chunks.at(chunk).endAddress;
+        m_nonBlankLineCount += m_chunks.at(chunk).nonBlankLineCount;
+        for (const Label& label : m_chunks.at(chunk).labels)
+            m_labels.append({ label.line, symbolIds.at(label.symbolId) });
+        m_errors += m_chunks.at(chunk).errors;
+    }
+
+    m_instructions.resize(instructionCount);
+    InstructionList& instructions = m_instructions;
+    const int *firstAddresses = m_chunkAddresses.constData();
+    const QVector<int> *symbolIdData = m_chunkSymbolIds.constData();
+    auto placeChunk = [lineCount, chunkCount, lineAddresses, &instructions, chunkData, firstAddresses, symbolIdData](int chunk) {
+        const int endLine = chunkFirstLine(chunk + 1, lineCount, chunkCount);
+        for (int line = chunkFirstLine(chunk, lineCount, chunkCount); line < endLine; line++)
+            lineAddresses[line] += firstAddresses[chunk];
+        instructions.copyFrom(firstAddresses[chunk], chunkData[chunk].instructions, symbolIdData[chunk].constData());
+    };
+    pool.run(chunkCount, std::cref(placeChunk));
+
+    rebuildLabelTable();
+}
+
+/**
+ * Parallel version of translateAll(). Chunks of instructions are encoded
+ * straight into their slice of the output. Symbols that are neither
+ * predefined nor labels are variables: their uses are collected per chunk
+ * and resolved afterwards in program order, so variables get the same
+ * addresses as when translating sequentially.
+ */
+void Assembler::translateAll(const WorkStealingPool& pool)
+{
+    if (!isParsed())
+        parse(pool);
+    clearTranslationData();
+
+    const int instructionCount = m_instructions.size();
+    const int chunkCount = parallelChunkCount(instructionCount, pool);
+    m_binaryCode.resize(instructionCount);
+
+    if (m_chunkVariables.size() < chunkCount)
+        m_chunkVariables.resize(chunkCount);
+    QVector<VariableUse> *variableData = m_chunkVariables.data();
+    quint16 *binaryCode = m_binaryCode.data();
+    const quint8 *kinds = m_instructions.kinds();
+    const quint16 *codes = m_instructions.codes().constData();
+    const int *symbolIds = m_instructions.symbolIds();
+    const SymbolTable& symbolTable = m_symbolTable;
+
+    auto translateChunk = [=, &symbolTable](int chunk) {
+        variableData[chunk].clear();
+        const int end = chunkFirstLine(chunk + 1, instructionCount, chunkCount);
+        for (int address = chunkFirstLine(chunk, instructionCount, chunkCount); address < end; address++) {
+            if (kinds[address] != InstructionList::SYMBOL) {
+                binaryCode[address] = codes[address];
+                continue;
+            }
+            uint symbolAddress = symbolTable.address(symbolIds[address]);
+            if (symbolAddress != SymbolTable::UNDEFINED)
+                binaryCode[address] = quint16(symbolAddress);
+            else
+                variableData[chunk].append({ address, symbolIds[address] });
+        }
+    };
+    pool.run(chunkCount, std::cref(translateChunk));
+
+    for (int chunk = 0; chunk < chunkCount; chunk++) {
+        for (const VariableUse& variable : m_chunkVariables.at(chunk))
+            binaryCode[variable.address] = quint16(m_symbolTable.addressWithAddVariable(variable.symbolId));
+    }
+}
+
+int Assembler::parallelChunkCount(int lineCount, const WorkStealingPool& pool)
+{
+    static const int MIN_CHUNK_LINES = 16384;
+    static const int CHUNKS_PER_THREAD = 8;
+    return qBound(1, lineCount / MIN_CHUNK_LINES, pool.threadCount() * CHUNKS_PER_THREAD);
+}
+
+int Assembler::chunkFirstLine(int chunk, int lineCount, int chunkCount)
+{
+    return int(qint64(lineCount) * chunk / chunkCount);
+}
+
+/**
+ * Replaces the errors of the removed lines with the new ones and moves the
+ * errors that follow by lineDelta lines.
+ */
+void Assembler::updateErrors(int firstLine, int removedCount, int lineDelta, const ErrorList& errors)
+{
+    auto byLine = [](const Error& error, int line) { return error.line < line; };
+    ErrorList::iterator begin = std::lower_bound(m_errors.begin(), m_errors.end(), firstLine, byLine);
+    ErrorList::iterator end = std::lower_bound(begin, m_errors.end(), firstLine + removedCount, byLine);
+    if (lineDelta != 0) {
+        for (ErrorList::iterator it = end; it != m_errors.end(); ++it)
+            it->line += lineDelta;
+    }
+    splice(m_errors, int(begin - m_errors.begin()), int(end - begin), errors);
+}
+
+void Assembler::rebuildLabelTable()
+{
+    m_symbolTable.clearLabels();
+    for (const Label& label : m_labels)
+        m_symbolTable.addLabel(label.symbolId, m_lineAddresses.at(label.line));
+}
+
+/**
+ * The second pass: every instruction is complete but for the addresses of
+ * symbols, which are looked up now that all labels are known.
+ */
 void Assembler::translateAll()
 {
+    if (!isParsed())
+        parse();
     clearTranslationData();
-    while (m_parser.hasMoreLines())
-        translateNextLine();
+
+    const int instructionCount = m_instructions.size();
+    m_binaryCode.resize(instructionCount);
+    quint16 *binaryCode = m_binaryCode.data();
+    std::copy_n(m_instructions.codes().constData(), instructionCount, binaryCode);
+    const quint8 *kinds = m_instructions.kinds();
+    const int *symbolIds = m_instructions.symbolIds();
+    for (int address = 0; address < instructionCount; address++) {
+        if (kinds[address] == InstructionList::SYMBOL)
+            binaryCode[address] = quint16(m_symbolTable.addressWithAddVariable(symbolIds[address]));
+    }
 }
 
 void Assembler::translateNextLine()
 {
-    m_parser.advance();
-
-    uint address;
-    switch (m_parser.commandType()) {
-    case Parser::C_COMMAND:
-        m_srcToBinLines[m_parser.currentLine()] = m_binaryCode.length();
-        m_binToSrcLines[m_binaryCode.length()] = m_parser.currentLine();
-        m_binaryCode.append("111" + Code::comp(m_parser.comp()) +
-                                    Code::dest(m_parser.dest()) +
-                                    Code::jump(m_parser.jump()));
-        break;
-
-    case Parser::A_COMMAND:
-        bool isNumeric;
-        address = m_parser.symbol().toUInt(&isNumeric);
-        if (!isNumeric)
-            address = m_symbolTable.getAddressWithAddEntry(m_parser.symbol());
-        m_srcToBinLines[m_parser.currentLine()] = m_binaryCode.length();
-        m_binToSrcLines[m_binaryCode.length()] = m_parser.currentLine();
-        m_binaryCode.append(QString::number(address, 2).rightJustified(16, '0'));
-        break;
-
-    default:
-        break;
-    }
+    const int address = m_binaryCode.size();
+    if (address >= m_instructions.size())
+        return;
+    if (address == 0)
+        m_binaryCode.reserve(m_instructions.size());
+    if (m_instructions.kind(address) == InstructionList::SYMBOL)
+        m_binaryCode.append(quint16(m_symbolTable.addressWithAddVariable(m_instructions.symbolId(address))));
+    else
+        m_binaryCode.append(m_instructions.code(address));
 }
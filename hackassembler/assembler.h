@@ -1,51 +1,125 @@
 #ifndef ASSEMBLER_H
 #define ASSEMBLER_H
 
-#include <QHash>
-#include <QList>
 #include <QString>
 #include <QStringList>
+#include <QVector>
+#include <vector>
 
-#include "parser.h"
+#include "instructionlist.h"
+#include "lexer.h"
+#include "sourcetext.h"
 #include "symboltable.h"
+#include "workstealingpool.h"
 
 class Assembler
 {
 public:
+    // The offending text is kept as a column range of the source line, so
+    // messages are only formatted for the errors that get shown.
     struct Error {
-        QString message;
         int line;
+        Lexer::ErrorType type;
+        int column;
+        int length;
+
+        QString message(QStringView sourceLine) const
+        {
+            return Lexer::errorMessage(type, sourceLine.mid(column, length));
+        }
     };
-    typedef QList<Error> ErrorList;
+    // Sorted by line.
+    typedef QVector<Error> ErrorList;
+
+    Assembler();
 
     void setSourceCode(const QString& asmSource);
-    const QStringList& asmSrcCode() const { return m_parser.asmSource(); }
-    const QStringList& binaryCode() const { return m_binaryCode; }
+    void replaceSourceLines(int firstLine, int removedCount, const QStringList& lines);
+    const SourceText& asmSrcCode() const { return m_asmSource; }
+    bool isSourceBlank() const { return m_nonBlankLineCount == 0; }
+    const QVector<quint16>& binaryCode() const { return m_binaryCode; }
 
     const ErrorList& errors() const { return m_errors; }
+    QString errorMessage(const Error& error) const { return error.message(asmSrcCode().line(error.line)); }
 
-    int sourceLineForBinaryLine(int binaryLineNumber);
-    int binaryLineForSourceLine(int sourceLineNumber);
+    int sourceLineForBinaryLine(int binaryLineNumber) const;
+    int binaryLineForSourceLine(int sourceLineNumber) const;
+    // Indexed by source line: the address of its instruction, or of the
+    // next one for lines without an instruction.
+    const QVector<int>& sourceToBinaryLines() const { return m_lineAddresses; }
+    // Indexed by address, for every parsed instruction.
+    const QVector<quint32>& binaryToSourceLines() const { return m_instructions.sourceLines(); }
+    const InstructionList& instructions() const { return m_instructions; }
 
     void parse();
+    void parse(const WorkStealingPool& pool);
     void translateAll();
+    void translateAll(const WorkStealingPool& pool);
     void translateNextLine();
-    inline bool hasMoreLines() const { return m_parser.hasMoreLines(); }
+    inline bool hasMoreLines() const { return m_binaryCode.size() < m_instructions.size(); }
 
     void clearParsingData();
     void clearTranslationData();
 
 private:
+    struct Label {
+        int line;
+        int symbolId;
+    };
 
-    Parser m_parser;
+    struct ParsedRange {
+        InstructionList instructions;
+        QVector<Label> labels;
+        ErrorList errors;
+        int nonBlankLineCount;
+        int endAddress;
+    };
+
+    struct VariableUse {
+        int address;
+        int symbolId;
+    };
+
+    void parseLines(int firstLine, int removedCount, int addedCount);
+    static void parseRange(const SourceText& source, int firstLine, int endLine, int firstAddress,
+                           int *lineAddresses, SymbolTable& symbols, ParsedRange& range);
+    static int parallelChunkCount(int lineCount, const WorkStealingPool& pool);
+    static int chunkFirstLine(int chunk, int lineCount, int chunkCount);
+    void updateErrors(int firstLine, int removedCount, int lineDelta, const ErrorList& errors);
+    void rebuildLabelTable();
+    int addressOfLine(int line) const;
+    bool isParsed() const { return m_lineAddresses.size() == m_asmSource.lineCount(); }
+
+    SourceText m_asmSource;
     SymbolTable m_symbolTable;
 
-    QStringList m_asmSrcCode;
-    QStringList m_binaryCode;
-    QHash<int, int> m_srcToBinLines;
-    QHash<int, int> m_binToSrcLines;
+    QVector<quint16> m_binaryCode;
+
+    // Parsing results, so an edit only re-lexes the lines it touched. Every
+    // later stage works from m_instructions, without the source text.
+    // m_lineAddresses holds the ROM address of each line's instruction, or
+    // of the next instruction for other lines.
+    InstructionList m_instructions;
+    QVector<int> m_lineAddresses;
+    QVector<Label> m_labels;
+    int m_nonBlankLineCount;
 
     ErrorList m_errors;
+
+    // Scratch space of parseLines(), reused by every edit.
+    ParsedRange m_editRange;
+    QVector<int> m_editLineAddresses;
+
+    // Per-chunk scratch space of the parallel passes, kept like the rest
+    // so that re-assembling does not allocate. Grows to the largest chunk
+    // count seen.
+    QVector<ParsedRange> m_chunks;
+    std::vector<SymbolTable> m_chunkSymbols;
+    QVector<int> m_chunkAddresses;
+    QVector<QVector<int> > m_chunkSymbolIds;
+    QVector<QVector<VariableUse> > m_chunkVariables;
 };
 
+Q_DECLARE_TYPEINFO(Assembler::Error, Q_PRIMITIVE_TYPE);
+
 #endif // ASSEMBLER_H
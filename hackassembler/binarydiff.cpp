@@ -0,0 +1,147 @@
+#include <QtAlgorithms>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "binarydiff.h"
+
+BinaryDiff::BinaryDiff()
+    : m_mismatchCount(0),
+      m_comparedCount(0)
+{
+}
+
+void BinaryDiff::compare(const quint16 *left, const quint16 *right, int count,
+                         const QVector<int>& alwaysDiffering)
+{
+    clear();
+    extend(left, right, count, alwaysDiffering);
+}
+
+/**
+ * The lines that always differ are rare, so the range is cut at each of
+ * them and the pieces in between go through the vectorized comparison.
+ */
+void BinaryDiff::extend(const quint16 *left, const quint16 *right, int count,
+                        const QVector<int>& alwaysDiffering)
+{
+    if (count <= m_comparedCount)
+        return;
+
+    int begin = m_comparedCount;
+    QVector<int>::const_iterator line = std::lower_bound(alwaysDiffering.constBegin(),
+                                                         alwaysDiffering.constEnd(), begin);
+    for (; line != alwaysDiffering.constEnd() && *line < count; ++line) {
+        compareRange(left, right, begin, *line);
+        addMismatches(*line, 1);
+        begin = *line + 1;
+    }
+    compareRange(left, right, begin, count);
+    m_comparedCount = count;
+}
+
+void BinaryDiff::clear()
+{
+    m_mismatches.clear();
+    m_mismatchCount = 0;
+    m_comparedCount = 0;
+}
+
+bool BinaryDiff::isMismatch(int line) const
+{
+    // The last run starting at or before line.
+    RangeList::const_iterator range = std::upper_bound(m_mismatches.constBegin(), m_mismatches.constEnd(), line,
+                                                       [](int line, const Range& range) { return line < range.first; });
+    if (range == m_mismatches.constBegin())
+        return false;
+    --range;
+    return line < range->end();
+}
+
+int BinaryDiff::nextMismatch(int line) const
+{
+    const int next = line + 1;
+    RangeList::const_iterator range = std::upper_bound(m_mismatches.constBegin(), m_mismatches.constEnd(), next,
+                                                       [](int line, const Range& range) { return line < range.first; });
+    if (range != m_mismatches.constBegin() && next < (range - 1)->end())
+        return next;
+    return range != m_mismatches.constEnd() ? range->first : -1;
+}
+
+int BinaryDiff::previousMismatch(int line) const
+{
+    const int previous = line - 1;
+    RangeList::const_iterator range = std::upper_bound(m_mismatches.constBegin(), m_mismatches.constEnd(), previous,
+                                                       [](int line, const Range& range) { return line < range.first; });
+    if (range == m_mismatches.constBegin())
+        return -1;
+    --range;
+    return qMin(previous, range->end() - 1);
+}
+
+/**
+ * Programs mostly agree, so the lines are compared 16 (AVX2) or 8 (SSE2) at
+ * a time, and only blocks with a difference are looked at line by line.
+ */
+void BinaryDiff::compareRange(const quint16 *left, const quint16 *right, int begin, int end)
+{
+    int i = begin;
+
+#if defined(__AVX2__)
+    for (; i + 16 <= end; i += 16) {
+        const __m256i leftBlock = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(left + i));
+        const __m256i rightBlock = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(right + i));
+        // Two mask bits per line, set where the lines differ.
+        uint mask = ~uint(_mm256_movemask_epi8(_mm256_cmpeq_epi16(leftBlock, rightBlock)));
+        if (mask == ~0u) {
+            addMismatches(i, 16);
+            continue;
+        }
+        while (mask) {
+            const uint bit = qCountTrailingZeroBits(mask);
+            addMismatches(i + int(bit / 2), 1);
+            mask &= ~(3u << bit);
+        }
+    }
+#elif defined(__SSE2__)
+    for (; i + 8 <= end; i += 8) {
+        const __m128i leftBlock = _mm_loadu_si128(reinterpret_cast<const __m128i *>(left + i));
+        const __m128i rightBlock = _mm_loadu_si128(reinterpret_cast<const __m128i *>(right + i));
+        // Two mask bits per line, set where the lines differ.
+        uint mask = ~uint(_mm_movemask_epi8(_mm_cmpeq_epi16(leftBlock, rightBlock))) & 0xffffu;
+        if (mask == 0xffffu) {
+            addMismatches(i, 8);
+            continue;
+        }
+        while (mask) {
+            const uint bit = qCountTrailingZeroBits(mask);
+            addMismatches(i + int(bit / 2), 1);
+            mask &= ~(3u << bit);
+        }
+    }
+#endif
+
+    for (; i < end; i++) {
+        if (left[i] != right[i])
+            addMismatches(i, 1);
+    }
+}
+
+/**
+ * Lines are added in order, so a run either grows the last one or starts
+ * after it.
+ */
+void BinaryDiff::addMismatches(int first, int count)
+{
+    if (!m_mismatches.isEmpty() && m_mismatches.last().end() == first) {
+        m_mismatches.last().count += count;
+    } else {
+        Range range = { first, count };
+        m_mismatches.append(range);
+    }
+    m_mismatchCount += count;
+}
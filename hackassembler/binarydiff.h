@@ -0,0 +1,52 @@
+#ifndef BINARYDIFF_H
+#define BINARYDIFF_H
+
+#include <QVector>
+
+// Line by line comparison of two programs, kept as the sorted runs of
+// lines on which they differ. Lines past the end of either program are
+// not compared.
+class BinaryDiff
+{
+public:
+    struct Range
+    {
+        int first;
+        int count;
+
+        int end() const { return first + count; }
+    };
+    typedef QVector<Range> RangeList;
+
+    BinaryDiff();
+
+    // Compares the first count lines of both programs. Lines in
+    // alwaysDiffering, which has to be sorted, differ whatever they hold.
+    void compare(const quint16 *left, const quint16 *right, int count,
+                 const QVector<int>& alwaysDiffering = QVector<int>());
+    // Compares lines from comparedCount() up to count, keeping the rest.
+    void extend(const quint16 *left, const quint16 *right, int count,
+                const QVector<int>& alwaysDiffering = QVector<int>());
+    void clear();
+
+    int comparedCount() const { return m_comparedCount; }
+    const RangeList& mismatches() const { return m_mismatches; }
+    int mismatchCount() const { return m_mismatchCount; }
+
+    bool isMismatch(int line) const;
+    // The closest differing line after or before line, or -1.
+    int nextMismatch(int line) const;
+    int previousMismatch(int line) const;
+
+private:
+    void compareRange(const quint16 *left, const quint16 *right, int begin, int end);
+    void addMismatches(int first, int count);
+
+    RangeList m_mismatches;
+    int m_mismatchCount;
+    int m_comparedCount;
+};
+
+Q_DECLARE_TYPEINFO(BinaryDiff::Range, Q_PRIMITIVE_TYPE);
+
+#endif // BINARYDIFF_H
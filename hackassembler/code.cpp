@@ -1,5 +1,64 @@
 #include "code.h"
 
+namespace {
+
+/**
+ * Every mnemonic is at most three characters long and each field only uses a
+ * handful of distinct characters. Mapping those characters to 4-bit classes
+ * and packing the classes of a mnemonic gives a perfect hash into a
+ * 4096-entry table, so an encoding is one small loop and one load.
+ * The tables are built by the compiler.
+ */
+const int MAX_MNEMONIC_LENGTH = 3;
+const int CLASS_BITS = 4;
+const int ASCII_SIZE = 128;
+const int KEY_COUNT = 1 << (CLASS_BITS * MAX_MNEMONIC_LENGTH);
+
+struct Mnemonic
+{
+    const char *text;
+    quint16 code;
+};
+
+struct MnemonicTable
+{
+    quint8 charClass[ASCII_SIZE];
+    quint16 codes[KEY_COUNT];
+};
+
+template <int N>
+constexpr MnemonicTable makeTable(const char *alphabet, const Mnemonic (&mnemonics)[N], int shift)
+{
+    MnemonicTable table {};
+    for (int i = 0; alphabet[i]; i++)
+        table.charClass[int(alphabet[i])] = quint8(i + 1);
+    for (int key = 0; key < KEY_COUNT; key++)
+        table.codes[key] = Code::INVALID;
+    for (int i = 0; i < N; i++) {
+        int key = 0;
+        for (int c = 0; mnemonics[i].text[c]; c++)
+            key |= table.charClass[int(mnemonics[i].text[c])] << (c * CLASS_BITS);
+        table.codes[key] = quint16(mnemonics[i].code << shift);
+    }
+    return table;
+}
+
+inline quint16 encode(const MnemonicTable& table, QStringView mnemonic)
+{
+    if (mnemonic.size() > MAX_MNEMONIC_LENGTH)
+        return Code::INVALID;
+    const QChar *chars = mnemonic.data();
+    uint key = 0;
+    for (int i = 0; i < int(mnemonic.size()); i++) {
+        ushort c = chars[i].unicode();
+        uint charClass = c < ASCII_SIZE ? table.charClass[c] : 0;
+        if (!charClass)
+            return Code::INVALID;
+        key |= charClass << (i * CLASS_BITS);
+    }
+    return table.codes[key];
+}
+
 /**
  * dest   d1 d2 d3
  * ---------------
@@ -12,13 +71,17 @@
  * AD     1  1  0
  * AMD    1  1  1
  */
-QString Code::dest(QString mnemonic)
-{
-    mnemonic = mnemonic.toUpper();
-    return QString::number(mnemonic.count('A')) +
-           QString::number(mnemonic.count('D')) +
-           QString::number(mnemonic.count('M'));
-}
+constexpr Mnemonic DEST_MNEMONICS[] = {
+    { "",    0b000 },
+    { "M",   0b001 },
+    { "D",   0b010 },
+    { "MD",  0b011 },
+    { "A",   0b100 },
+    { "AM",  0b101 },
+    { "AD",  0b110 },
+    { "AMD", 0b111 }
+};
+constexpr MnemonicTable DEST_TABLE = makeTable("ADM", DEST_MNEMONICS, 3);
 
 /**
  * jump   j1 j2 j3
@@ -32,25 +95,17 @@ QString Code::dest(QString mnemonic)
  * JLE    1  1  0
  * JMP    1  1  1
  */
-QString Code::jump(QString mnemonic)
-{
-    mnemonic = mnemonic.toUpper();
-    if (mnemonic == "JGT")
-        return "001";
-    else if (mnemonic == "JEQ")
-        return "010";
-    else if (mnemonic == "JGE")
-        return "011";
-    else if (mnemonic == "JLT")
-        return "100";
-    else if (mnemonic == "JNE")
-        return "101";
-    else if (mnemonic == "JLE")
-        return "110";
-    else if (mnemonic == "JMP")
-        return "111";
-    return "000";
-}
+constexpr Mnemonic JUMP_MNEMONICS[] = {
+    { "",    0b000 },
+    { "JGT", 0b001 },
+    { "JEQ", 0b010 },
+    { "JGE", 0b011 },
+    { "JLT", 0b100 },
+    { "JNE", 0b101 },
+    { "JLE", 0b110 },
+    { "JMP", 0b111 }
+};
+constexpr MnemonicTable JUMP_TABLE = makeTable("JGTEQLNMP", JUMP_MNEMONICS, 0);
 
 /**
  * C-instruction: dest=comp;jump
@@ -82,50 +137,85 @@ QString Code::jump(QString mnemonic)
  *        D&A   0  0  0  0  0  0    D&M
  *        D|A   0  1  0  1  0  1    D|M
  */
-QString Code::comp(QString mnemonic)
+constexpr Mnemonic COMP_MNEMONICS[] = {
+    { "0",   0b0101010 },
+    { "1",   0b0111111 },
+    { "-1",  0b0111010 },
+    { "D",   0b0001100 },
+    { "A",   0b0110000 }, { "M",   0b1110000 },
+    { "!D",  0b0001101 },
+    { "!A",  0b0110001 }, { "!M",  0b1110001 },
+    { "-D",  0b0001111 },
+    { "-A",  0b0110011 }, { "-M",  0b1110011 },
+    { "D+1", 0b0011111 },
+    { "A+1", 0b0110111 }, { "M+1", 0b1110111 },
+    { "D-1", 0b0001110 },
+    { "A-1", 0b0110010 }, { "M-1", 0b1110010 },
+    { "D+A", 0b0000010 }, { "D+M", 0b1000010 },
+    { "D-A", 0b0010011 }, { "D-M", 0b1010011 },
+    { "A-D", 0b0000111 }, { "M-D", 0b1000111 },
+    { "D&A", 0b0000000 }, { "D&M", 0b1000000 },
+    { "D|A", 0b0010101 }, { "D|M", 0b1010101 }
+};
+constexpr MnemonicTable COMP_TABLE = makeTable("01-!DAM+&|", COMP_MNEMONICS, 6);
+
+} // namespace
+
+/**
+ * The empty mnemonic is the <NULL> destination.
+ */
+quint16 Code::dest(QStringView mnemonic)
+{
+    return encode(DEST_TABLE, mnemonic);
+}
+
+/**
+ * The empty mnemonic is the <NULL> jump.
+ */
+quint16 Code::jump(QStringView mnemonic)
+{
+    return encode(JUMP_TABLE, mnemonic);
+}
+
+/**
+ * Includes the "a" bit, so M variants come out with bit 12 set.
+ */
+quint16 Code::comp(QStringView mnemonic)
+{
+    return encode(COMP_TABLE, mnemonic);
+}
+
+/**
+ * Text form of an instruction word, most significant bit first, as it is
+ * shown in the editor and written to .hack files.
+ */
+QString Code::binaryString(quint16 instruction)
+{
+    QString text(16, QLatin1Char('0'));
+    QChar *bits = text.data();
+    for (int i = 15; i >= 0; i--, instruction >>= 1) {
+        if (instruction & 1)
+            bits[i] = QLatin1Char('1');
+    }
+    return text;
+}
+
+void Code::writeBinaryString(quint16 instruction, char *text)
+{
+    for (int i = 15; i >= 0; i--, instruction >>= 1)
+        text[i] = (instruction & 1) ? '1' : '0';
+}
+
+/**
+ * One binaryString() per line, newline terminated.
+ */
+QByteArray Code::hackFileContents(const QVector<quint16>& instructions)
 {
-    mnemonic = mnemonic.toUpper();
-    QString code(7, '0');
-
-    if (mnemonic == "0")
-        code = "0101010";
-    else if (mnemonic == "1")
-        code = "0111111";
-    else if (mnemonic == "-1")
-        code = "0111010";
-    else if (mnemonic == "D")
-        code = "0001100";
-    else if (mnemonic == "A" || mnemonic == "M")
-        code = "0110000";
-    else if (mnemonic == "!D")
-        code = "0001101";
-    else if (mnemonic == "!A" || mnemonic == "!M")
-        code = "0110001";
-    else if (mnemonic == "-D")
-        code = "0001111";
-    else if (mnemonic == "-A" || mnemonic == "-M")
-        code = "0110011";
-    else if (mnemonic == "D+1")
-        code = "0011111";
-    else if (mnemonic == "A+1" || mnemonic == "M+1")
-        code = "0110111";
-    else if (mnemonic == "D-1")
-        code = "0001110";
-    else if (mnemonic == "A-1" || mnemonic == "M-1")
-        code = "0110010";
-    else if (mnemonic == "D+A" || mnemonic == "D+M")
-        code = "0000010";
-    else if (mnemonic == "D-A" || mnemonic == "D-M")
-        code = "0010011";
-    else if (mnemonic == "A-D" || mnemonic == "M-D")
-        code = "0000111";
-    else if (mnemonic == "D&A" || mnemonic == "D&M")
-        code = "0000000";
-    else if (mnemonic == "D|A" || mnemonic == "D|M")
-        code = "0010101";
-
-    if (mnemonic.contains("M"))
-        code[0] = '1';
-
-    return code;
+    QByteArray contents(instructions.size() * 17, '\n');
+    char *line = contents.data();
+    for (quint16 instruction : instructions) {
+        writeBinaryString(instruction, line);
+        line += 17;
+    }
+    return contents;
 }
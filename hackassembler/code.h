@@ -1,13 +1,29 @@
 #ifndef CODE_H
 #define CODE_H
 
+#include <QByteArray>
 #include <QString>
+#include <QStringView>
+#include <QVector>
 
 namespace Code
 {
-    QString dest(QString mnemonic);
-    QString jump(QString mnemonic);
-    QString comp(QString mnemonic);
+    // Returned by the encoders for mnemonics that are not part of the language.
+    const quint16 INVALID = 0xffff;
+
+    // Fixed "111" prefix of every C-instruction.
+    const quint16 C_INSTRUCTION = 0xe000;
+
+    // The encoders return the field bits already shifted into place, so a
+    // C-instruction is C_INSTRUCTION | comp() | dest() | jump().
+    quint16 dest(QStringView mnemonic);
+    quint16 jump(QStringView mnemonic);
+    quint16 comp(QStringView mnemonic);
+
+    QString binaryString(quint16 instruction);
+    // Writes the 16 characters of binaryString() to text.
+    void writeBinaryString(quint16 instruction, char *text);
+    QByteArray hackFileContents(const QVector<quint16>& instructions);
 }
 
 #endif // CODE_H
@@ -0,0 +1,37 @@
+# Hack assembler core, shared by the editor and the hackasm command-line tool.
+# It only depends on QtCore.
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    $$PWD/aligneddiff.cpp \
+    $$PWD/arena.cpp \
+    $$PWD/assembler.cpp \
+    $$PWD/binarydiff.cpp \
+    $$PWD/code.cpp \
+    $$PWD/hackbinaryfile.cpp \
+    $$PWD/instructionlist.cpp \
+    $$PWD/lexer.cpp \
+    $$PWD/mappedfile.cpp \
+    $$PWD/parser.cpp \
+    $$PWD/sourcetext.cpp \
+    $$PWD/streamingassembler.cpp \
+    $$PWD/symboltable.cpp \
+    $$PWD/workstealingpool.cpp
+
+HEADERS += \
+    $$PWD/aligneddiff.h \
+    $$PWD/arena.h \
+    $$PWD/assembler.h \
+    $$PWD/binarydiff.h \
+    $$PWD/code.h \
+    $$PWD/hackbinaryfile.h \
+    $$PWD/instructionlist.h \
+    $$PWD/lexer.h \
+    $$PWD/mappedfile.h \
+    $$PWD/parser.h \
+    $$PWD/sourcetext.h \
+    $$PWD/splice.h \
+    $$PWD/streamingassembler.h \
+    $$PWD/symboltable.h \
+    $$PWD/workstealingpool.h
@@ -0,0 +1,202 @@
+#include <climits>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "hackbinaryfile.h"
+
+namespace {
+
+// How far into the file the first line break is looked for.
+const int MAX_STRIDE_LINE_LENGTH = 64;
+// How many rows, evenly spread over the file, are checked against the stride.
+const int STRIDE_SAMPLE_ROWS = 64;
+const int INSTRUCTION_DIGIT_COUNT = 16;
+
+bool isBlank(const char *line, qint64 length)
+{
+    for (qint64 i = 0; i < length; i++) {
+        if (line[i] != ' ' && line[i] != '\t' && line[i] != '\r' && line[i] != '\v' && line[i] != '\f')
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Decodes 16 binary digits. With SSE2 all of them are checked and turned
+ * into bits at once; the first digit ends up in the lowest mask bit, so the
+ * bit order is reversed afterwards.
+ */
+inline bool decodeInstruction(const char *digits, quint16 *instruction)
+{
+#if defined(__SSE2__)
+    const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(digits));
+    const __m128i zeroOrOne = _mm_cmpeq_epi8(_mm_and_si128(chars, _mm_set1_epi8(char(0xfe))), _mm_set1_epi8('0'));
+    if (_mm_movemask_epi8(zeroOrOne) != 0xffff)
+        return false;
+    // The low bit of each digit, moved up to where movemask picks it.
+    uint bits = uint(_mm_movemask_epi8(_mm_slli_epi16(chars, 7)));
+    bits = ((bits & 0x5555) << 1) | ((bits >> 1) & 0x5555);
+    bits = ((bits & 0x3333) << 2) | ((bits >> 2) & 0x3333);
+    bits = ((bits & 0x0f0f) << 4) | ((bits >> 4) & 0x0f0f);
+    *instruction = quint16((bits << 8) | (bits >> 8));
+    return true;
+#else
+    quint16 value = 0;
+    for (int i = 0; i < INSTRUCTION_DIGIT_COUNT; i++) {
+        if (digits[i] != '0' && digits[i] != '1')
+            return false;
+        value = quint16(value << 1) | quint16(digits[i] - '0');
+    }
+    *instruction = value;
+    return true;
+#endif
+}
+
+} // namespace
+
+HackBinaryFile::HackBinaryFile()
+    : m_rowCount(0),
+      m_rowStride(0),
+      m_rowLength(0)
+{
+}
+
+bool HackBinaryFile::open(const QString& filename)
+{
+    close();
+    if (!m_file.open(filename))
+        return false;
+    if (!detectRowStride())
+        indexRows();
+    return true;
+}
+
+void HackBinaryFile::close()
+{
+    m_file.close();
+    m_rowCount = 0;
+    m_rowStride = 0;
+    m_rowLength = 0;
+    m_rowStarts.clear();
+}
+
+QString HackBinaryFile::rowText(int row) const
+{
+    int length;
+    const char *data = rowData(row, &length);
+    return QString::fromLatin1(data, length);
+}
+
+bool HackBinaryFile::instruction(int row, quint16 *instruction) const
+{
+    int length;
+    const char *data = rowData(row, &length);
+    return length == INSTRUCTION_DIGIT_COUNT && decodeInstruction(data, instruction);
+}
+
+void HackBinaryFile::decodeInstructions(int firstRow, int count, quint16 *instructions,
+                                        QVector<int> *invalidRows) const
+{
+    for (int i = 0; i < count; i++) {
+        int length;
+        const char *data = rowData(firstRow + i, &length);
+        if (length != INSTRUCTION_DIGIT_COUNT || !decodeInstruction(data, instructions + i)) {
+            instructions[i] = 0;
+            invalidRows->append(firstRow + i);
+        }
+    }
+}
+
+const char *HackBinaryFile::rowData(int row, int *length) const
+{
+    Q_ASSERT(row >= 0 && row < m_rowCount);
+    if (m_rowStride > 0) {
+        *length = m_rowLength;
+        return m_file.data() + qint64(row) * m_rowStride;
+    }
+
+    const qint64 start = m_rowStarts.at(row);
+    const char *data = m_file.data() + start;
+    const qint64 available = m_file.size() - start;
+    const char *newline = static_cast<const char *>(memchr(data, '\n', size_t(available)));
+    qint64 end = newline ? newline - data : available;
+    if (end > 0 && data[end - 1] == '\r')
+        end--;
+    *length = int(end);
+    return data;
+}
+
+/**
+ * Takes the length of the first line for the length of all of them, which
+ * holds if the file size, the last line and a sample of the lines in
+ * between agree with it; otherwise the rows are indexed. A line that does
+ * not fit and is missed by the sample is then shown cut at the wrong
+ * places, much like a differing row; it is not worth reading the whole file
+ * to rule that out.
+ */
+bool HackBinaryFile::detectRowStride()
+{
+    const char *data = m_file.data();
+    const qint64 size = m_file.size();
+    if (size == 0)
+        return false;
+    const size_t searched = size_t(qMin<qint64>(size, MAX_STRIDE_LINE_LENGTH));
+    const char *newline = static_cast<const char *>(memchr(data, '\n', searched));
+    if (!newline)
+        return false;
+
+    const int stride = int(newline - data) + 1;
+    int length = stride - 1;
+    if (length > 0 && data[length - 1] == '\r')
+        length--;
+    if (length == 0 || isBlank(data, length))
+        return false;
+
+    // The last line may lack its line break.
+    qint64 rowCount = size / stride;
+    const qint64 rest = size % stride;
+    if (rest != 0 && rest != length)
+        return false;
+    if (rest != 0)
+        rowCount++;
+    if (rowCount > INT_MAX)
+        return false;
+
+    const char *lastRow = data + (rowCount - 1) * stride;
+    if (memchr(lastRow, '\n', size_t(length)) || memchr(lastRow, '\r', size_t(length)))
+        return false;
+    if (rest == 0 && memcmp(lastRow + length, data + length, size_t(stride - length)) != 0)
+        return false;
+
+    const qint64 fullRowCount = rest == 0 ? rowCount : rowCount - 1;
+    const int sampleCount = int(qMin<qint64>(fullRowCount, STRIDE_SAMPLE_ROWS));
+    for (int sample = 1; sample < sampleCount; sample++) {
+        const char *row = data + (fullRowCount - 1) * sample / (sampleCount - 1) * stride;
+        if (memcmp(row + length, data + length, size_t(stride - length)) != 0
+                || memchr(row, '\n', size_t(length)) || memchr(row, '\r', size_t(length)))
+            return false;
+    }
+
+    m_rowCount = int(rowCount);
+    m_rowStride = stride;
+    m_rowLength = length;
+    return true;
+}
+
+void HackBinaryFile::indexRows()
+{
+    const char *data = m_file.data();
+    const qint64 size = m_file.size();
+    qint64 start = 0;
+    while (start < size) {
+        const char *newline = static_cast<const char *>(memchr(data + start, '\n', size_t(size - start)));
+        const qint64 end = newline ? newline - data : size;
+        if (!isBlank(data + start, end - start))
+            m_rowStarts.append(start);
+        start = end + 1;
+    }
+    m_rowCount = m_rowStarts.size();
+}
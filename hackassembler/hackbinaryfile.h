@@ -0,0 +1,44 @@
+#ifndef HACKBINARYFILE_H
+#define HACKBINARYFILE_H
+
+#include <QString>
+#include <QVector>
+
+#include "mappedfile.h"
+
+// A .hack file opened for random access to its lines, which are only
+// located and decoded when asked for. Blank lines are skipped.
+// When every line has the same length, as assembler output does, a row is
+// found by arithmetic and opening takes the same time for any file size.
+// Other files get the start of each row indexed when they are opened.
+class HackBinaryFile
+{
+public:
+    HackBinaryFile();
+
+    bool open(const QString& filename);
+    void close();
+
+    int rowCount() const { return m_rowCount; }
+    // The row as written in the file, without its line break.
+    QString rowText(int row) const;
+    // False unless the row is 16 binary digits.
+    bool instruction(int row, quint16 *instruction) const;
+    // Decodes count rows from firstRow in one pass. Rows that are not
+    // instructions come out as 0 and are appended to invalidRows.
+    void decodeInstructions(int firstRow, int count, quint16 *instructions, QVector<int> *invalidRows) const;
+
+private:
+    const char *rowData(int row, int *length) const;
+    bool detectRowStride();
+    void indexRows();
+
+    MappedFile m_file;
+    int m_rowCount;
+    // Bytes from one row to the next, or 0 when m_rowStarts is used.
+    int m_rowStride;
+    int m_rowLength;
+    QVector<qint64> m_rowStarts;
+};
+
+#endif // HACKBINARYFILE_H
@@ -0,0 +1,58 @@
+#include <cstring>
+
+#include "instructionlist.h"
+#include "splice.h"
+
+void InstructionList::clear()
+{
+    m_kinds.clear();
+    m_codes.clear();
+    m_symbolIds.clear();
+    m_sourceLines.clear();
+}
+
+void InstructionList::resize(int size)
+{
+    m_kinds.resize(size);
+    m_codes.resize(size);
+    m_symbolIds.resize(size);
+    m_sourceLines.resize(size);
+}
+
+void InstructionList::append(Kind kind, quint16 code, int symbolId, int sourceLine)
+{
+    m_kinds.append(kind);
+    m_codes.append(code);
+    m_symbolIds.append(symbolId);
+    m_sourceLines.append(quint32(sourceLine));
+}
+
+void InstructionList::replace(int first, int removedCount, const InstructionList& inserted, int lineDelta)
+{
+    splice(m_kinds, first, removedCount, inserted.m_kinds);
+    splice(m_codes, first, removedCount, inserted.m_codes);
+    splice(m_symbolIds, first, removedCount, inserted.m_symbolIds);
+    splice(m_sourceLines, first, removedCount, inserted.m_sourceLines);
+    if (lineDelta != 0) {
+        quint32 *sourceLines = m_sourceLines.data();
+        for (int i = first + inserted.size(); i < m_sourceLines.size(); i++)
+            sourceLines[i] += lineDelta;
+    }
+}
+
+/**
+ * The columns are detached by resize() beforehand, so that taking their
+ * data here does not copy them.
+ */
+void InstructionList::copyFrom(int first, const InstructionList& other, const int *symbolIds)
+{
+    const int count = other.size();
+    Q_ASSERT(first + count <= size());
+    std::memcpy(m_kinds.data() + first, other.m_kinds.constData(), count * sizeof(quint8));
+    std::memcpy(m_codes.data() + first, other.m_codes.constData(), count * sizeof(quint16));
+    std::memcpy(m_sourceLines.data() + first, other.m_sourceLines.constData(), count * sizeof(quint32));
+    int *ids = m_symbolIds.data() + first;
+    const int *otherIds = other.m_symbolIds.constData();
+    for (int i = 0; i < count; i++)
+        ids[i] = otherIds[i] >= 0 ? symbolIds[otherIds[i]] : -1;
+}
@@ -0,0 +1,49 @@
+#ifndef INSTRUCTIONLIST_H
+#define INSTRUCTIONLIST_H
+
+#include <QVector>
+
+// The parsed instructions of a program in ROM order, one array per field,
+// so that each pass reads only the columns it needs. C-instructions and
+// constants are complete in their code; the other A-instructions name a
+// symbol, whose address is only known once labels are resolved.
+class InstructionList
+{
+public:
+    enum Kind : quint8 {
+        CONSTANT,   // @123
+        SYMBOL,     // @Xxx
+        COMPUTE     // dest=comp;jump
+    };
+
+    int size() const { return m_kinds.size(); }
+    void clear();
+    void resize(int size);
+    void append(Kind kind, quint16 code, int symbolId, int sourceLine);
+
+    Kind kind(int index) const { return Kind(m_kinds.at(index)); }
+    quint16 code(int index) const { return m_codes.at(index); }
+    int symbolId(int index) const { return m_symbolIds.at(index); }
+    int sourceLine(int index) const { return int(m_sourceLines.at(index)); }
+
+    const quint8 *kinds() const { return m_kinds.constData(); }
+    const QVector<quint16>& codes() const { return m_codes; }
+    const int *symbolIds() const { return m_symbolIds.constData(); }
+    const QVector<quint32>& sourceLines() const { return m_sourceLines; }
+
+    // Replaces removedCount instructions from first with inserted, and moves
+    // the source lines of the instructions after them by lineDelta.
+    void replace(int first, int removedCount, const InstructionList& inserted, int lineDelta);
+    // Writes other over the instructions from first, which must exist,
+    // translating its symbol ids through symbolIds. Disjoint ranges can be
+    // written concurrently.
+    void copyFrom(int first, const InstructionList& other, const int *symbolIds);
+
+private:
+    QVector<quint8> m_kinds;
+    QVector<quint16> m_codes;
+    QVector<int> m_symbolIds;    // For SYMBOL, otherwise -1
+    QVector<quint32> m_sourceLines;
+};
+
+#endif // INSTRUCTIONLIST_H
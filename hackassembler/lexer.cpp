@@ -0,0 +1,246 @@
+#include "code.h"
+#include "lexer.h"
+
+namespace {
+
+enum CharClass : quint8
+{
+    SPACE        = 1 << 0,
+    DIGIT        = 1 << 1,
+    SYMBOL_START = 1 << 2,   // [a-zA-Z_.$:]
+    SYMBOL       = 1 << 3    // [a-zA-Z0-9_.$:]
+};
+
+const int ASCII_SIZE = 128;
+
+struct CharClassTable
+{
+    quint8 classes[ASCII_SIZE];
+};
+
+constexpr CharClassTable makeCharClassTable()
+{
+    CharClassTable table {};
+    for (int c = 0; c < ASCII_SIZE; c++) {
+        bool isLetter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        bool isDigit = c >= '0' && c <= '9';
+        bool isSymbolPunctuation = c == '_' || c == '.' || c == '$' || c == ':';
+        bool isSpace = c == ' ' || (c >= '\t' && c <= '\r');
+        table.classes[c] = quint8((isSpace ? SPACE : 0) |
+                                  (isDigit ? DIGIT : 0) |
+                                  (isLetter || isSymbolPunctuation ? SYMBOL_START : 0) |
+                                  (isLetter || isDigit || isSymbolPunctuation ? SYMBOL : 0));
+    }
+    return table;
+}
+
+constexpr CharClassTable CHAR_CLASSES = makeCharClassTable();
+
+// Outside of ASCII the classes follow QString::trimmed() and QRegExp's \w.
+inline bool isSpace(QChar c)
+{
+    return c.unicode() < ASCII_SIZE ? (CHAR_CLASSES.classes[c.unicode()] & SPACE) : c.isSpace();
+}
+
+inline bool isSymbolChar(QChar c)
+{
+    return c.unicode() < ASCII_SIZE ? (CHAR_CLASSES.classes[c.unicode()] & SYMBOL)
+                                    : (c.isLetterOrNumber() || c.isMark());
+}
+
+inline QStringView view(const QChar *begin, const QChar *end)
+{
+    return QStringView(begin, end - begin);
+}
+
+const QChar *findChar(const QChar *begin, const QChar *end, ushort c, int& count)
+{
+    const QChar *first = end;
+    count = 0;
+    for (const QChar *p = begin; p < end; p++) {
+        if (p->unicode() == c && count++ == 0)
+            first = p;
+    }
+    return first;
+}
+
+} // namespace
+
+/**
+  * Classifies and validates one source line in a single left to right pass,
+  * without allocating: comments and surrounding whitespace are skipped and
+  * every field is returned as a view of the line.
+  *
+  * Invalid C-instructions still get a code (the plain "111" prefix) so that
+  * they keep their place in the translation.
+  */
+Lexer::Line Lexer::lex(QStringView sourceLine)
+{
+    Line line;
+    line.commandType = NO_COMMAND;
+    line.error = VALID;
+    line.code = 0;
+    line.isConstant = false;
+
+    const QChar *begin = sourceLine.data();
+    const QChar *end = begin + sourceLine.size();
+
+    for (const QChar *c = begin; c + 1 < end; c++) {
+        if (c->unicode() == '/' && c[1].unicode() == '/') {
+            line.comment = view(c, end);
+            end = c;
+            break;
+        }
+    }
+    while (begin < end && isSpace(*begin))
+        begin++;
+    while (end > begin && isSpace(end[-1]))
+        end--;
+    line.command = view(begin, end);
+
+    if (begin == end)
+        return line;
+
+    // @Xxx
+    if (begin->unicode() == '@') {
+        line.commandType = A_COMMAND;
+        QStringView address = view(begin + 1, end);
+        if (isValidConstant(address)) {
+            uint value = 0;
+            for (QChar digit : address)
+                value = value * 10 + (digit.unicode() - '0');
+            line.isConstant = true;
+            line.code = quint16(value);
+            line.symbol = address;
+        } else if (isValidSymbol(address)) {
+            line.symbol = address;
+        } else {
+            line.error = INVALID_ADDRESS;
+            line.errorText = address;
+        }
+        return line;
+    }
+
+    // (Xxx)
+    if (begin->unicode() == '(' && end[-1].unicode() == ')' && end - begin >= 2) {
+        line.commandType = L_COMMAND;
+        QStringView label = view(begin + 1, end - 1);
+        if (isValidSymbol(label)) {
+            line.symbol = label;
+        } else {
+            line.error = INVALID_LABEL;
+            line.errorText = label;
+        }
+        return line;
+    }
+
+    // DEST=comp;jump
+    line.commandType = C_COMMAND;
+    line.code = Code::C_INSTRUCTION;
+    int count;
+    const QChar *equals = findChar(begin, end, '=', count);
+    if (count == 1) {
+        line.dest = view(begin, equals);
+        quint16 dest = Code::dest(line.dest);
+        if (line.dest.isEmpty() || dest == Code::INVALID) {
+            line.error = INVALID_DESTINATION;
+            line.errorText = line.dest;
+            line.dest = QStringView();
+            return line;
+        }
+        line.code |= dest;
+        begin = equals + 1;
+    }
+
+    // dest=comp;JUMP
+    const QChar *semicolon = findChar(begin, end, ';', count);
+    if (count == 1) {
+        line.jump = view(semicolon + 1, end);
+        quint16 jump = Code::jump(line.jump);
+        if (line.jump.isEmpty() || jump == Code::INVALID) {
+            line.error = INVALID_JUMP;
+            line.errorText = line.jump;
+            line.dest = line.jump = QStringView();
+            line.code = Code::C_INSTRUCTION;
+            return line;
+        }
+        line.code |= jump;
+        end = semicolon;
+    }
+
+    // dest=COMP;jump
+    line.comp = view(begin, end);
+    quint16 comp = Code::comp(line.comp);
+    if (comp == Code::INVALID) {
+        line.error = INVALID_COMPUTATION;
+        line.errorText = line.comp;
+        line.dest = line.comp = line.jump = QStringView();
+        line.code = Code::C_INSTRUCTION;
+        return line;
+    }
+    line.code |= comp;
+    return line;
+}
+
+QString Lexer::errorMessage(ErrorType error, QStringView errorText)
+{
+    switch (error) {
+    case INVALID_ADDRESS:
+        return QString("Invalid symbol or constant: '%1'").arg(errorText.toString());
+    case INVALID_LABEL:
+        return QString("Invalid label: '%1'").arg(errorText.toString());
+    case INVALID_DESTINATION:
+        return QString("Invalid destination: '%1'").arg(errorText.toString());
+    case INVALID_JUMP:
+        return QString("Invalid jump: '%1'").arg(errorText.toString());
+    case INVALID_COMPUTATION:
+        return QString("Invalid computation: '%1'").arg(errorText.toString());
+    default:
+        break;
+    }
+    return QString();
+}
+
+/**
+  * A user-defined symbol can be any sequence of letters, digits, underscore (_),
+  * dot (.), dollar sign ($), and colon (:) that does not begin with a digit.
+  */
+bool Lexer::isValidSymbol(QStringView symbol)
+{
+    if (symbol.isEmpty())
+        return false;
+    ushort first = symbol.at(0).unicode();
+    if (first >= ASCII_SIZE || !(CHAR_CLASSES.classes[first] & SYMBOL_START))
+        return false;
+    for (QChar c : symbol.mid(1)) {
+        if (!isSymbolChar(c))
+            return false;
+    }
+    return true;
+}
+
+/**
+  * Constants must be non-negative and are written in decimal notation.
+  */
+bool Lexer::isValidConstant(QStringView constant)
+{
+    if (constant.isEmpty())
+        return false;
+    for (QChar c : constant) {
+        if (c.unicode() >= ASCII_SIZE || !(CHAR_CLASSES.classes[c.unicode()] & DIGIT))
+            return false;
+    }
+    return true;
+}
+
+/**
+  * True for lines with nothing but whitespace, not even a comment.
+  */
+bool Lexer::isBlank(QStringView sourceLine)
+{
+    for (QChar c : sourceLine) {
+        if (!isSpace(c))
+            return false;
+    }
+    return true;
+}
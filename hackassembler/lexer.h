@@ -0,0 +1,57 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <QString>
+#include <QStringView>
+
+class Lexer
+{
+public:
+    enum CommandType
+    {
+        NO_COMMAND,
+        A_COMMAND,       // Addressing instruction for "@Xxx" (A-instruction)
+        C_COMMAND,       // Compute instruction for "dest=comp;jump" (C-instruction)
+        L_COMMAND        // Pseucocommand for "(Xxx)" (L-instruction)
+    };
+
+    enum ErrorType
+    {
+        VALID,
+        INVALID_ADDRESS,
+        INVALID_LABEL,
+        INVALID_DESTINATION,
+        INVALID_JUMP,
+        INVALID_COMPUTATION
+    };
+
+    // Result of lexing one source line. The views point into that line.
+    struct Line
+    {
+        CommandType commandType;
+        ErrorType error;
+        QStringView symbol;     // Symbol or constant of A and L commands
+        QStringView dest;
+        QStringView comp;
+        QStringView jump;
+        QStringView errorText;  // Offending field, when error is not VALID
+        QStringView command;    // The line without comment and surrounding whitespace
+        QStringView comment;    // From "//" to the end of the line
+        quint16 code;           // Whole C-instruction, or the value of a constant
+        bool isConstant;
+
+        inline bool hasError() const { return error != VALID; }
+    };
+
+    static Line lex(QStringView sourceLine);
+
+    static QString errorMessage(ErrorType error, QStringView errorText);
+
+    static bool isValidSymbol(QStringView symbol);
+    static bool isValidConstant(QStringView constant);
+    static bool isBlank(QStringView sourceLine);
+};
+
+Q_DECLARE_TYPEINFO(Lexer::Line, Q_MOVABLE_TYPE);
+
+#endif // LEXER_H
@@ -0,0 +1,69 @@
+#include <QTextCodec>
+
+#include "mappedfile.h"
+
+MappedFile::MappedFile()
+    : m_map(NULL),
+      m_data(NULL),
+      m_size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+/**
+ * Mapping only reserves address space; pages are read in when they are
+ * first touched, so opening costs the same for any file size.
+ */
+bool MappedFile::open(const QString& filename)
+{
+    close();
+    m_file.setFileName(filename);
+    if (!m_file.open(QFile::ReadOnly))
+        return false;
+
+    m_size = m_file.size();
+    if (m_size > 0) {
+        m_map = m_file.map(0, m_size);
+        if (m_map) {
+            m_data = reinterpret_cast<const char *>(m_map);
+        } else {
+            m_contents = m_file.readAll();
+            m_size = m_contents.size();
+            m_data = m_contents.constData();
+        }
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_map)
+        m_file.unmap(m_map);
+    m_file.close();
+    m_map = NULL;
+    m_contents.clear();
+    m_data = NULL;
+    m_size = 0;
+}
+
+/**
+ * Decodes straight from the mapped pages, with the locale's codec unless
+ * the contents start with a Unicode byte order mark, and turns "\r\n" into
+ * "\n".
+ */
+QString MappedFile::text() const
+{
+    if (m_size == 0)
+        return QString();
+
+    const QByteArray head = QByteArray::fromRawData(m_data, int(qMin<qint64>(m_size, 4)));
+    QTextCodec *codec = QTextCodec::codecForUtfText(head, QTextCodec::codecForLocale());
+    QString text = codec->toUnicode(m_data, int(m_size));
+    if (text.contains(QLatin1Char('\r')))
+        text.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+    return text;
+}
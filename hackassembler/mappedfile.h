@@ -0,0 +1,39 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+// Read-only access to a whole file without copying it. The file is
+// memory-mapped and stays open while it is; where the file system does not
+// support mapping, it is read into memory instead.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const QString& filename);
+    void close();
+
+    bool isOpen() const { return m_file.isOpen(); }
+    const char *data() const { return m_data; }
+    qint64 size() const { return m_size; }
+    QString errorString() const { return m_file.errorString(); }
+
+    // The contents decoded the way QTextStream reads a file opened with
+    // QIODevice::Text.
+    QString text() const;
+
+private:
+    Q_DISABLE_COPY(MappedFile)
+
+    QFile m_file;
+    uchar *m_map;
+    QByteArray m_contents;
+    const char *m_data;
+    qint64 m_size;
+};
+
+#endif // MAPPEDFILE_H
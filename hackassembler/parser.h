@@ -2,59 +2,42 @@
 #define PARSER_H
 
 #include <QString>
-#include <QStringList>
+#include <QStringView>
+
+#include "lexer.h"
+#include "sourcetext.h"
 
 class Parser
 {
 public:
-    enum CommandType
-    {
-        NO_COMMAND,
-        A_COMMAND,       // Addressing instruction for "@Xxx" (A-instruction)
-        C_COMMAND,       // Compute instruction for "dest=comp;jump" (C-instruction)
-        L_COMMAND        // Pseucocommand for "(Xxx)" (L-instruction)
-    };
-
-    void setAsmSource(const QStringList& asmSource);
-    const QStringList& asmSource() const { return m_asmSource; }
+    void setAsmSource(const SourceText& asmSource);
+    const SourceText& asmSource() const { return m_asmSource; }
     void reset();
 
     int currentLine() { return m_currentLine; }
     bool hasMoreLines() const;
     void advance();
 
-    CommandType commandType() const { return m_currentCommandType; }
-    const QString& symbol() const { return m_symbol; }
-    const QString& dest() const { return m_dest; }
-    const QString& comp() const { return m_comp; }
-    const QString& jump() const { return m_jump; }
-    const QString& error() const { return m_error; }
+    Lexer::CommandType commandType() const { return m_current.commandType; }
+    QStringView symbol() const { return m_current.symbol; }
+    QStringView dest() const { return m_current.dest; }
+    QStringView comp() const { return m_current.comp; }
+    QStringView jump() const { return m_current.jump; }
+    QString error() const { return Lexer::errorMessage(m_current.error, m_current.errorText); }
+
+    // Complete C-instruction, or the value of a constant A-instruction.
+    quint16 code() const { return m_current.code; }
+    bool isConstant() const { return m_current.isConstant; }
 
-    inline bool hasError() const { return !m_error.isEmpty(); }
+    inline bool hasError() const { return m_current.hasError(); }
 
 private:
     void clearParseData();
 
-    QString removeComment(const QString& sourceLine) const;
-    void processACommand(const QString& sourceLine);
-    void processLCommand(const QString& sourceLine);
-    void processCCommand(QString sourceLine);
-
-    bool isValidSymbol(const QString& symbol) const;
-    bool isValidConstant(const QString& constant) const;
-    bool isValidCommand(const QString& command) const;
-    bool isValidDestination(const QString& dest) const;
-    bool isValidJump(const QString& jump) const;
-
-    QStringList m_asmSource;
+    SourceText m_asmSource;
     int m_currentLine;
 
-    CommandType m_currentCommandType;
-    QString m_symbol;
-    QString m_dest;
-    QString m_comp;
-    QString m_jump;
-    QString m_error;
+    Lexer::Line m_current;
 };
 
 #endif // PARSER_H
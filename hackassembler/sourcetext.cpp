@@ -0,0 +1,196 @@
+#include <algorithm>
+
+#include <QtAlgorithms>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "sourcetext.h"
+
+namespace {
+
+/**
+ * A "\r" directly followed by "\n" is one line break, which ends at the "\n".
+ */
+template <typename LineStartVisitor>
+inline void lineBreakAt(const ushort *text, int size, int i, LineStartVisitor& visitLineStart)
+{
+    if (text[i] == '\r' && i + 1 < size && text[i + 1] == '\n')
+        return;
+    visitLineStart(i + 1);
+}
+
+/**
+ * Calls visitLineStart with the offset following every line break in the
+ * text. Line breaks are rare next to the other characters, so the text is
+ * compared 16 (AVX2) or 8 (SSE2) characters at a time against "\n" and "\r",
+ * and only the matches are looked at one by one.
+ */
+template <typename LineStartVisitor>
+void scanLineBreaks(QStringView text, LineStartVisitor visitLineStart)
+{
+    const ushort *chars = reinterpret_cast<const ushort *>(text.data());
+    const int size = int(text.size());
+    int i = 0;
+
+#if defined(__AVX2__)
+    const __m256i newline = _mm256_set1_epi16('\n');
+    const __m256i carriageReturn = _mm256_set1_epi16('\r');
+    for (; i + 16 <= size; i += 16) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(chars + i));
+        const __m256i matches = _mm256_or_si256(_mm256_cmpeq_epi16(block, newline),
+                                                _mm256_cmpeq_epi16(block, carriageReturn));
+        // Two mask bits per character.
+        uint mask = uint(_mm256_movemask_epi8(matches));
+        while (mask) {
+            const uint bit = qCountTrailingZeroBits(mask);
+            lineBreakAt(chars, size, i + int(bit / 2), visitLineStart);
+            mask &= ~(3u << bit);
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi16('\n');
+    const __m128i carriageReturn = _mm_set1_epi16('\r');
+    for (; i + 8 <= size; i += 8) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(chars + i));
+        const __m128i matches = _mm_or_si128(_mm_cmpeq_epi16(block, newline),
+                                             _mm_cmpeq_epi16(block, carriageReturn));
+        // Two mask bits per character.
+        uint mask = uint(_mm_movemask_epi8(matches));
+        while (mask) {
+            const uint bit = qCountTrailingZeroBits(mask);
+            lineBreakAt(chars, size, i + int(bit / 2), visitLineStart);
+            mask &= ~(3u << bit);
+        }
+    }
+#endif
+
+    for (; i < size; i++) {
+        if (chars[i] == '\n' || chars[i] == '\r')
+            lineBreakAt(chars, size, i, visitLineStart);
+    }
+}
+
+} // namespace
+
+SourceText::SourceText()
+{
+    setText(QString());
+}
+
+SourceText::SourceText(const QString& text)
+{
+    setText(text);
+}
+
+/**
+ * The text is copied into the buffer of the previous one, which only
+ * allocates when it grows.
+ */
+void SourceText::setText(const QString& text)
+{
+    m_text.resize(text.size());
+    std::copy(text.constBegin(), text.constEnd(), m_text.begin());
+    m_lineStarts.clear();
+    m_lineStarts.append(0);
+    QVector<int>& lineStarts = m_lineStarts;
+    scanLineBreaks(m_text, [&lineStarts](int lineStart) { lineStarts.append(lineStart); });
+}
+
+/**
+ * Replaces removedCount lines starting at firstLine with the given lines.
+ * The text is spliced in one go and only the offsets of the lines after the
+ * edit are shifted; nothing outside the edit is scanned again. All of it is
+ * done in place, so an edit allocates nothing unless the text or the number
+ * of lines grows past what it ever was.
+ */
+void SourceText::replaceLines(int firstLine, int removedCount, const QStringList& lines)
+{
+    const int lineCount = m_lineStarts.size();
+    const int endLine = firstLine + removedCount;
+    Q_ASSERT(firstLine >= 0 && removedCount >= 0 && endLine <= lineCount);
+
+    // The replaced range includes the line break after the removed lines,
+    // or the one before them when they are the last ones.
+    QString& inserted = m_inserted;
+    inserted.resize(0);
+    int position;
+    int firstLineStart;
+    if (endLine < lineCount) {
+        position = m_lineStarts.at(firstLine);
+        for (const QString& line : lines) {
+            inserted += line;
+            inserted += QLatin1Char('\n');
+        }
+        firstLineStart = position;
+    } else if (!lines.isEmpty()) {
+        position = firstLine < lineCount ? m_lineStarts.at(firstLine) : m_text.size();
+        if (firstLine == lineCount && lineCount > 0)
+            inserted += QLatin1Char('\n');
+        firstLineStart = position + inserted.size();
+        for (int i = 0; i < lines.size(); i++) {
+            if (i > 0)
+                inserted += QLatin1Char('\n');
+            inserted += lines.at(i);
+        }
+    } else {
+        position = firstLine > 0 ? lineEnd(firstLine - 1) : 0;
+        firstLineStart = position;
+    }
+    const int replacedEnd = endLine < lineCount ? m_lineStarts.at(endLine) : m_text.size();
+    m_text.replace(position, replacedEnd - position, inserted);
+    // A lone "\r" line break before the edit must not pair up with a "\n"
+    // that now follows it. Turning it into a "\n" could pair it with a "\r"
+    // before it in turn, so the whole run of them is converted.
+    if (position < m_text.size() && m_text.at(position) == QLatin1Char('\n')) {
+        for (int i = position - 1; i >= 0 && m_text.at(i) == QLatin1Char('\r'); i--)
+            m_text[i] = QLatin1Char('\n');
+    }
+
+    // Make room for the offsets of the inserted lines, or drop those of the
+    // removed lines that have no replacement, then fill them in.
+    const int lineDelta = lines.size() - removedCount;
+    if (lineDelta > 0)
+        m_lineStarts.insert(endLine, lineDelta, 0);
+    else if (lineDelta < 0)
+        m_lineStarts.remove(firstLine + lines.size(), -lineDelta);
+    for (int i = 0; i < lines.size(); i++) {
+        m_lineStarts[firstLine + i] = firstLineStart;
+        firstLineStart += lines.at(i).size() + 1;
+    }
+
+    const int offsetDelta = inserted.size() - (replacedEnd - position);
+    if (offsetDelta != 0) {
+        for (int line = firstLine + lines.size(); line < m_lineStarts.size(); line++)
+            m_lineStarts[line] += offsetDelta;
+    }
+}
+
+/**
+ * Offset just past the last character of the line, before its line break.
+ */
+int SourceText::lineEnd(int line) const
+{
+    if (line + 1 == m_lineStarts.size())
+        return m_text.size();
+    int end = m_lineStarts.at(line + 1) - 1;
+    if (end > m_lineStarts.at(line) && m_text.at(end) == QLatin1Char('\n') && m_text.at(end - 1) == QLatin1Char('\r'))
+        end--;
+    return end;
+}
+
+QStringView SourceText::line(int line) const
+{
+    const int start = m_lineStarts.at(line);
+    return QStringView(m_text.constData() + start, lineEnd(line) - start);
+}
+
+int SourceText::countLines(QStringView text)
+{
+    int lineCount = 1;
+    scanLineBreaks(text, [&lineCount](int) { lineCount++; });
+    return lineCount;
+}
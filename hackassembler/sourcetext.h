@@ -0,0 +1,38 @@
+#ifndef SOURCETEXT_H
+#define SOURCETEXT_H
+
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <QVector>
+
+// The source code as one buffer plus the offset where each line starts.
+// Lines end at "\n", "\r\n" or "\r", like QString::split() with
+// QRegExp("\n|\r\n|\r") would cut them, but without a QString per line.
+// The text is copied rather than shared, so edits never detach it, and they
+// splice it in through a scratch buffer that every edit reuses.
+class SourceText
+{
+public:
+    SourceText();
+    explicit SourceText(const QString& text);
+
+    void setText(const QString& text);
+    void replaceLines(int firstLine, int removedCount, const QStringList& lines);
+
+    const QString& text() const { return m_text; }
+    int lineCount() const { return m_lineStarts.size(); }
+    int lineStart(int line) const { return m_lineStarts.at(line); }
+    int lineEnd(int line) const;
+    QStringView line(int line) const;
+
+    static int countLines(QStringView text);
+
+private:
+    QString m_text;
+    QVector<int> m_lineStarts;
+    // What replaceLines() splices in.
+    QString m_inserted;
+};
+
+#endif // SOURCETEXT_H
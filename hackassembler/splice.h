@@ -0,0 +1,22 @@
+#ifndef SPLICE_H
+#define SPLICE_H
+
+#include <QVector>
+#include <algorithm>
+
+// Replaces removedCount elements of vector from first with inserted,
+// overwriting in place as far as the counts allow.
+template <typename T>
+void splice(QVector<T>& vector, int first, int removedCount, const QVector<T>& inserted)
+{
+    const int common = qMin(removedCount, inserted.size());
+    std::copy(inserted.constBegin(), inserted.constBegin() + common, vector.begin() + first);
+    if (removedCount > common) {
+        vector.erase(vector.begin() + first + common, vector.begin() + first + removedCount);
+    } else if (inserted.size() > common) {
+        vector.insert(first + common, inserted.size() - common, T());
+        std::copy(inserted.constBegin() + common, inserted.constEnd(), vector.begin() + first + common);
+    }
+}
+
+#endif // SPLICE_H
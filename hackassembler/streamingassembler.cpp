@@ -0,0 +1,197 @@
+#include <QTextStream>
+
+#include "code.h"
+#include "lexer.h"
+#include "streamingassembler.h"
+
+namespace {
+
+// Every instruction takes 16 binary digits and a newline in the output, so
+// instruction n starts at byte n * LINE_SIZE.
+const int LINE_SIZE = 17;
+const int DIGIT_COUNT = 16;
+const int OUTPUT_BLOCK_SIZE = LINE_SIZE * 4096;
+const qint64 NO_USE = -1;
+
+} // namespace
+
+const int StreamingAssembler::MAX_REPORTED_ERRORS = 100;
+
+StreamingAssembler::StreamingAssembler()
+    : m_output(NULL),
+      m_lineCount(0),
+      m_instructionCount(0),
+      m_errorCount(0)
+{
+}
+
+/**
+  * Reads the input line by line and writes the .hack text to the output,
+  * which must be open for reading too, since the placeholders are read back
+  * when they get patched.
+  *
+  * A label may only be defined once, and may not redefine a predefined
+  * symbol, because references that follow a definition are resolved
+  * straight away.
+  */
+bool StreamingAssembler::assemble(QIODevice *input, QIODevice *output)
+{
+    m_output = output;
+    m_outputBuffer.clear();
+    m_outputBuffer.reserve(OUTPUT_BLOCK_SIZE + LINE_SIZE);
+    m_symbolTable.clear();
+    m_lastUnresolvedUse.clear();
+    m_lineCount = 0;
+    m_instructionCount = 0;
+    m_errorCount = 0;
+    m_errorMessages.clear();
+    m_ioError.clear();
+
+    if (output->isSequential()) {
+        m_ioError = "Output device is not random access";
+        return false;
+    }
+
+    QTextStream source(input);
+    QString sourceLine;
+    while (source.readLineInto(&sourceLine)) {
+        m_lineCount++;
+        assembleLine(sourceLine);
+        if (m_outputBuffer.size() >= OUTPUT_BLOCK_SIZE && !flushOutput())
+            return false;
+    }
+    if (source.status() != QTextStream::Ok) {
+        m_ioError = input->errorString();
+        return false;
+    }
+
+    if (!flushOutput())
+        return false;
+    if (m_errorCount > 0)
+        return false;
+    return patchPlaceholders();
+}
+
+void StreamingAssembler::assembleLine(const QString& sourceLine)
+{
+    const Lexer::Line line = Lexer::lex(sourceLine);
+    if (line.hasError())
+        addError(Lexer::errorMessage(line.error, line.errorText));
+
+    int symbolId;
+    uint address;
+    switch (line.commandType) {
+    case Lexer::C_COMMAND:
+        emitInstruction(line.code);
+        break;
+
+    case Lexer::A_COMMAND:
+        if (line.isConstant || line.hasError()) {
+            emitInstruction(line.code);
+            break;
+        }
+        symbolId = internSymbol(line.symbol);
+        address = m_symbolTable.address(symbolId);
+        if (address != SymbolTable::UNDEFINED)
+            emitInstruction(quint16(address));
+        else
+            emitPlaceholder(symbolId);
+        break;
+
+    case Lexer::L_COMMAND:
+        if (line.hasError())
+            break;
+        symbolId = internSymbol(line.symbol);
+        if (m_symbolTable.address(symbolId) != SymbolTable::UNDEFINED)
+            addError(QString("Symbol already defined: '%1'").arg(line.symbol.toString()));
+        else
+            m_symbolTable.addLabel(symbolId, uint(m_instructionCount));
+        break;
+
+    default:
+        break;
+    }
+}
+
+int StreamingAssembler::internSymbol(QStringView symbol)
+{
+    const int symbolId = m_symbolTable.intern(symbol);
+    if (symbolId == m_lastUnresolvedUse.size())
+        m_lastUnresolvedUse.append(NO_USE);
+    return symbolId;
+}
+
+void StreamingAssembler::emitInstruction(quint16 instruction)
+{
+    const int offset = m_outputBuffer.size();
+    m_outputBuffer.resize(offset + LINE_SIZE);
+    char *line = m_outputBuffer.data() + offset;
+    Code::writeBinaryString(instruction, line);
+    line[DIGIT_COUNT] = '\n';
+    m_instructionCount++;
+}
+
+/**
+  * The placeholder holds the previous unresolved use of the symbol as 16 hex
+  * digits, all f's for none, which links the uses of the symbol into a chain
+  * through the output.
+  */
+void StreamingAssembler::emitPlaceholder(int symbolId)
+{
+    const int offset = m_outputBuffer.size();
+    m_outputBuffer.resize(offset + LINE_SIZE);
+    char *line = m_outputBuffer.data() + offset;
+    const QByteArray previousUse = QByteArray::number(quint64(m_lastUnresolvedUse.at(symbolId)), 16);
+    memset(line, '0', DIGIT_COUNT - previousUse.size());
+    memcpy(line + DIGIT_COUNT - previousUse.size(), previousUse.constData(), previousUse.size());
+    line[DIGIT_COUNT] = '\n';
+    m_lastUnresolvedUse[symbolId] = m_instructionCount;
+    m_instructionCount++;
+}
+
+void StreamingAssembler::addError(const QString& message)
+{
+    if (m_errorCount < MAX_REPORTED_ERRORS)
+        m_errorMessages << QString("%1: %2").arg(m_lineCount).arg(message);
+    m_errorCount++;
+}
+
+bool StreamingAssembler::flushOutput()
+{
+    if (m_output->write(m_outputBuffer) != m_outputBuffer.size()) {
+        m_ioError = m_output->errorString();
+        return false;
+    }
+    m_outputBuffer.clear();
+    return true;
+}
+
+/**
+  * Symbols that were never defined as labels are variables. Walking the ids
+  * in order allocates them in order of first use, as Assembler does.
+  */
+bool StreamingAssembler::patchPlaceholders()
+{
+    char digits[DIGIT_COUNT];
+    for (int symbolId = 0; symbolId < m_lastUnresolvedUse.size(); symbolId++) {
+        qint64 use = m_lastUnresolvedUse.at(symbolId);
+        if (use == NO_USE)
+            continue;
+
+        const quint16 address = quint16(m_symbolTable.addressWithAddVariable(symbolId));
+        while (use != NO_USE) {
+            if (!m_output->seek(use * LINE_SIZE) || m_output->read(digits, DIGIT_COUNT) != DIGIT_COUNT) {
+                m_ioError = m_output->errorString();
+                return false;
+            }
+            const qint64 previousUse = qint64(QByteArray::fromRawData(digits, DIGIT_COUNT).toULongLong(NULL, 16));
+            Code::writeBinaryString(address, digits);
+            if (!m_output->seek(use * LINE_SIZE) || m_output->write(digits, DIGIT_COUNT) != DIGIT_COUNT) {
+                m_ioError = m_output->errorString();
+                return false;
+            }
+            use = previousUse;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef STREAMINGASSEMBLER_H
+#define STREAMINGASSEMBLER_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <QVector>
+
+#include "symboltable.h"
+
+// Single-pass assembler for inputs too large to hold in memory. Every line
+// is lexed once and its instruction written out right away. A symbol that
+// is not yet known when it is used is written as a placeholder, which holds
+// the position of the symbol's previous unresolved use; once the whole
+// input has been read, each symbol's chain of placeholders is patched in
+// the output. Memory therefore grows with the number of symbols only.
+class StreamingAssembler
+{
+public:
+    static const int MAX_REPORTED_ERRORS;
+
+    StreamingAssembler();
+
+    // The output has to be random access, since placeholders are patched
+    // in place. Returns false on errors in the source or on I/O errors.
+    bool assemble(QIODevice *input, QIODevice *output);
+
+    qint64 lineCount() const { return m_lineCount; }
+    qint64 instructionCount() const { return m_instructionCount; }
+
+    // "line: message" for the first MAX_REPORTED_ERRORS errors.
+    qint64 errorCount() const { return m_errorCount; }
+    const QStringList& errorMessages() const { return m_errorMessages; }
+    const QString& ioError() const { return m_ioError; }
+
+private:
+    void assembleLine(const QString& sourceLine);
+    int internSymbol(QStringView symbol);
+    void emitInstruction(quint16 instruction);
+    void emitPlaceholder(int symbolId);
+    void addError(const QString& message);
+    bool flushOutput();
+    bool patchPlaceholders();
+
+    QIODevice *m_output;
+    QByteArray m_outputBuffer;
+    SymbolTable m_symbolTable;
+    // Per symbol id: the instruction that last used it while it was still
+    // unresolved, or -1.
+    QVector<qint64> m_lastUnresolvedUse;
+
+    qint64 m_lineCount;
+    qint64 m_instructionCount;
+    qint64 m_errorCount;
+    QStringList m_errorMessages;
+    QString m_ioError;
+};
+
+#endif // STREAMINGASSEMBLER_H
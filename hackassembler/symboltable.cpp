@@ -1,13 +1,41 @@
+#include <QHash>
+
 #include "symboltable.h"
 
-SymbolTable::SymbolTable()
+namespace {
+
+struct PredefinedSymbol
 {
-    clear();
+    const char *name;
+    uint address;
+};
+
+/**
+ * The named predefined symbols all differ in (length, last character), and
+ * (last + 5 * length) mod 16 keeps them apart, so one probe and one compare
+ * decide a lookup. R0..R15 are recognised by their digits instead.
+ */
+const int PREDEFINED_SLOTS = 16;
+const int REGISTER_COUNT = 16;
+
+constexpr int predefinedSlot(ushort lastChar, int length)
+{
+    return int((lastChar + 5 * uint(length)) % PREDEFINED_SLOTS);
 }
 
-void SymbolTable::clear()
+constexpr int nameLength(const char *name)
+{
+    return *name ? 1 + nameLength(name + 1) : 0;
+}
+
+struct PredefinedTable
+{
+    PredefinedSymbol slots[PREDEFINED_SLOTS];
+};
+
+constexpr PredefinedTable makePredefinedTable()
 {
-    m_symbolTable = {
+    const PredefinedSymbol symbols[] = {
         { "SP",     0x0000 },
         { "LCL",    0x0001 },
         { "ARG",    0x0002 },
@@ -16,44 +44,169 @@ void SymbolTable::clear()
         { "SCREEN", 0x4000 },
         { "KBD",    0x6000 }
     };
+    PredefinedTable table {};
+    for (const PredefinedSymbol& symbol : symbols) {
+        const int length = nameLength(symbol.name);
+        table.slots[predefinedSlot(ushort(symbol.name[length - 1]), length)] = symbol;
+    }
+    return table;
+}
+
+constexpr PredefinedTable PREDEFINED_TABLE = makePredefinedTable();
+
+const int MIN_SLOT_COUNT = 64;
+
+inline uint symbolHash(QStringView symbol)
+{
+    return qHash(symbol);
+}
+
+} // namespace
 
-    for (uint i = 0; i < 16; i++)
-        m_symbolTable["R" + QByteArray::number(i)] = i;
+SymbolTable::SymbolTable()
+{
+    clear();
+}
 
+/**
+ * Forgets every interned symbol. Ids handed out before are invalid after this.
+ * The arrays and the name arena keep their memory for the next symbols.
+ */
+void SymbolTable::clear()
+{
+    m_nameArena.reset();
+    m_names.clear();
+    m_hashes.clear();
+    m_addresses.clear();
+    m_slots.fill(-1, qMax(m_slots.size(), MIN_SLOT_COUNT));
+    m_labelIds.clear();
+    clearVariables();
+}
+
+/**
+ * Undefines the labels, which gives predefined symbols that were redefined as
+ * labels their original address back.
+ */
+void SymbolTable::clearLabels()
+{
+    for (int id : m_labelIds)
+        m_addresses[id] = predefinedAddress(m_names.at(id));
+    m_labelIds.clear();
+}
+
+/**
+ * Forgets the variables allocated by a translation, keeping the predefined
+ * symbols and the labels found by parsing.
+ */
+void SymbolTable::clearVariables()
+{
+    for (int id : m_variableIds)
+        m_addresses[id] = UNDEFINED;
+    m_variableIds.clear();
     m_nextMemoryPos = 16;
 }
 
-uint SymbolTable::addEntry(const QString& symbol)
+/**
+ * Returns the id of the symbol, adding it if it was not seen before. New
+ * symbols start with their predefined address, if they have one.
+ */
+int SymbolTable::intern(QStringView symbol)
 {
-    uint address = m_nextMemoryPos;
-    addEntry(symbol, address);
-    m_nextMemoryPos++;
-    return address;
+    const uint hash = symbolHash(symbol);
+    const int mask = m_slots.size() - 1;
+    for (int slot = int(hash) & mask; m_slots.at(slot) >= 0; slot = (slot + 1) & mask) {
+        const int id = m_slots.at(slot);
+        if (m_hashes.at(id) == hash && symbol == m_names.at(id))
+            return id;
+    }
+
+    const int id = m_names.size();
+    m_names.append(m_nameArena.copy(symbol));
+    m_hashes.append(hash);
+    m_addresses.append(predefinedAddress(symbol));
+    if (2 * m_names.size() > m_slots.size()) {
+        m_slots.fill(-1, 2 * m_slots.size());
+        for (int i = 0; i < m_names.size(); i++)
+            insertSlot(i, m_hashes.at(i));
+    } else {
+        insertSlot(id, hash);
+    }
+    return id;
 }
 
-void SymbolTable::addEntry(const QString& symbol, uint address)
+int SymbolTable::find(QStringView symbol) const
 {
-    m_symbolTable[symbol] = address;
+    const uint hash = symbolHash(symbol);
+    const int mask = m_slots.size() - 1;
+    for (int slot = int(hash) & mask; m_slots.at(slot) >= 0; slot = (slot + 1) & mask) {
+        const int id = m_slots.at(slot);
+        if (m_hashes.at(id) == hash && symbol == m_names.at(id))
+            return id;
+    }
+    return -1;
 }
 
-bool SymbolTable::contains(const QString& symbol) const
+void SymbolTable::insertSlot(int id, uint hash)
 {
-    return m_symbolTable.contains(symbol);
+    const int mask = m_slots.size() - 1;
+    int slot = int(hash) & mask;
+    while (m_slots.at(slot) >= 0)
+        slot = (slot + 1) & mask;
+    m_slots[slot] = id;
 }
 
-uint SymbolTable::getAddress(const QString& symbol, bool& found) const
+void SymbolTable::addLabel(int id, uint address)
 {
-    found = contains(symbol);
-    if (found)
-        return m_symbolTable[symbol];
-    return 0;
+    if (m_addresses.at(id) == predefinedAddress(m_names.at(id)))
+        m_labelIds.append(id);
+    m_addresses[id] = address;
 }
 
-uint SymbolTable::getAddressWithAddEntry(const QString& symbol)
+uint SymbolTable::addVariable(int id)
 {
-    bool found;
-    uint address = getAddress(symbol, found);
-    if (found)
+    uint address = m_nextMemoryPos;
+    m_addresses[id] = address;
+    m_variableIds.append(id);
+    m_nextMemoryPos++;
+    return address;
+}
+
+uint SymbolTable::addressWithAddVariable(int id)
+{
+    uint address = m_addresses.at(id);
+    if (address != UNDEFINED)
         return address;
-    return addEntry(symbol);
+    return addVariable(id);
+}
+
+/**
+ * Address of SP, LCL, ARG, THIS, THAT, SCREEN, KBD or R0..R15, otherwise
+ * UNDEFINED. Needs no table lookups beyond a single slot.
+ */
+uint SymbolTable::predefinedAddress(QStringView symbol)
+{
+    const int length = int(symbol.size());
+    if (length < 2)
+        return UNDEFINED;
+
+    const QChar *chars = symbol.data();
+    if (chars[0] == QLatin1Char('R') && length <= 3) {
+        uint value = 0;
+        for (int i = 1; i < length; i++) {
+            ushort digit = ushort(chars[i].unicode() - '0');
+            if (digit > 9 || (i == 1 && digit == 0 && length > 2))
+                return UNDEFINED;
+            value = value * 10 + digit;
+        }
+        return value < REGISTER_COUNT ? value : UNDEFINED;
+    }
+
+    const PredefinedSymbol& entry = PREDEFINED_TABLE.slots[predefinedSlot(chars[length - 1].unicode(), length)];
+    if (!entry.name || nameLength(entry.name) != length)
+        return UNDEFINED;
+    for (int i = 0; i < length; i++) {
+        if (chars[i] != QLatin1Char(entry.name[i]))
+            return UNDEFINED;
+    }
+    return entry.address;
 }
@@ -1,27 +1,51 @@
 #ifndef SYMBOLTABLE_H
 #define SYMBOLTABLE_H
 
-#include <QHash>
 #include <QString>
+#include <QStringView>
+#include <QVector>
+
+#include "arena.h"
 
 class SymbolTable
 {
 public:
+    static const uint UNDEFINED = ~0u;
+
     SymbolTable();
 
     void clear();
+    void clearLabels();
+    void clearVariables();
+
+    // Symbols are interned once into dense ids, which index the addresses.
+    int intern(QStringView symbol);
+    int find(QStringView symbol) const;
+    int symbolCount() const { return m_names.size(); }
+    QStringView name(int id) const { return m_names.at(id); }
 
-    uint addEntry(const QString& symbol);
-    void addEntry(const QString& symbol, uint address);
+    void addLabel(int id, uint address);
+    uint addVariable(int id);
 
-    bool contains(const QString& symbol) const;
+    // UNDEFINED when the symbol is neither predefined, a label nor a variable.
+    uint address(int id) const { return m_addresses.at(id); }
+    uint addressWithAddVariable(int id);
 
-    uint getAddress(const QString& symbol, bool& found) const;
-    uint getAddressWithAddEntry(const QString& symbol);
+    static uint predefinedAddress(QStringView symbol);
 
 private:
-    // { Symbol: RAM Address }
-    QHash<QString, uint> m_symbolTable;
+    void insertSlot(int id, uint hash);
+
+    // Mutable overlay over the predefined symbols: the interned names with
+    // their current address, and an open-addressing index of the names.
+    // The names are kept in an arena that clear() releases at once.
+    Arena m_nameArena;
+    QVector<QStringView> m_names;
+    QVector<uint> m_hashes;
+    QVector<uint> m_addresses;
+    QVector<int> m_slots;
+    QVector<int> m_labelIds;
+    QVector<int> m_variableIds;
     uint m_nextMemoryPos;
 };
 
@@ -0,0 +1,195 @@
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QThread>
+
+#include "workstealingpool.h"
+
+namespace {
+
+struct WorkRange
+{
+    std::mutex lock;
+    int begin;
+    int end;
+};
+
+// One batch: the slice of tasks of each of its workers. The ranges belong
+// to the pool and are reused by every batch.
+struct Job
+{
+    Job(int taskCount, int workerCount, WorkRange *ranges, const std::function<void(int)>& task)
+        : ranges(ranges), workerCount(workerCount), task(task)
+    {
+        for (int worker = 0; worker < workerCount; worker++) {
+            ranges[worker].begin = int(qint64(taskCount) * worker / workerCount);
+            ranges[worker].end = int(qint64(taskCount) * (worker + 1) / workerCount);
+        }
+    }
+
+    WorkRange *ranges;
+    int workerCount;
+    const std::function<void(int)>& task;
+};
+
+bool takeFirst(WorkRange& range, int& task)
+{
+    std::lock_guard<std::mutex> guard(range.lock);
+    if (range.begin >= range.end)
+        return false;
+    task = range.begin++;
+    return true;
+}
+
+bool stealHalf(WorkRange& victim, int& begin, int& end)
+{
+    std::lock_guard<std::mutex> guard(victim.lock);
+    int remaining = victim.end - victim.begin;
+    if (remaining <= 0)
+        return false;
+    end = victim.end;
+    begin = victim.end - (remaining + 1) / 2;
+    victim.end = begin;
+    return true;
+}
+
+/**
+  * Each worker starts on its own contiguous slice of the tasks and, when it
+  * runs dry, steals the back half of another worker's remaining slice, so a
+  * few expensive tasks do not leave the other threads idle.
+  */
+void work(Job& job, int self)
+{
+    const int workerCount = job.workerCount;
+    WorkRange& own = job.ranges[self];
+    for (;;) {
+        int current;
+        while (takeFirst(own, current))
+            job.task(current);
+
+        // Ranges only ever shrink, so a full round without finding
+        // anything to steal means every task has been claimed.
+        bool stole = false;
+        for (int offset = 1; offset < workerCount && !stole; offset++) {
+            int begin, end;
+            if (stealHalf(job.ranges[(self + offset) % workerCount], begin, end)) {
+                std::lock_guard<std::mutex> guard(own.lock);
+                own.begin = begin;
+                own.end = end;
+                stole = true;
+            }
+        }
+        if (!stole)
+            return;
+    }
+}
+
+} // namespace
+
+// The threads and what they share. Worker 0 is the thread calling run();
+// thread i - 1 is worker i.
+struct WorkStealingPool::Workers
+{
+    Workers() : job(NULL), jobNumber(0), busyCount(0), quit(false) {}
+
+    void loop(int self);
+
+    std::mutex runLock;
+    std::mutex lock;
+    std::condition_variable jobStarted;
+    std::condition_variable jobFinished;
+    Job *job;
+    quint64 jobNumber;
+    // Workers of the current job that have not finished their part.
+    int busyCount;
+    bool quit;
+    std::vector<std::thread> threads;
+    std::vector<WorkRange> ranges;
+};
+
+/**
+  * Workers beyond the job's own worker count sit it out, and may only wake
+  * up once it is over. The others always get to it, as run() waits for them.
+  */
+void WorkStealingPool::Workers::loop(int self)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    quint64 seenJobNumber = 0;
+    for (;;) {
+        jobStarted.wait(guard, [this, seenJobNumber]() { return quit || jobNumber != seenJobNumber; });
+        if (quit)
+            return;
+        seenJobNumber = jobNumber;
+        Job *current = job;
+        if (current == NULL || self >= current->workerCount)
+            continue;
+
+        guard.unlock();
+        work(*current, self);
+        guard.lock();
+        if (--busyCount == 0)
+            jobFinished.notify_one();
+    }
+}
+
+WorkStealingPool::WorkStealingPool(int threadCount)
+    : m_threadCount(threadCount),
+      m_workers(new Workers)
+{
+    if (m_threadCount <= 0)
+        m_threadCount = qMax(1, QThread::idealThreadCount());
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_workers->lock);
+        m_workers->quit = true;
+    }
+    m_workers->jobStarted.notify_all();
+    for (std::thread& thread : m_workers->threads)
+        thread.join();
+    delete m_workers;
+}
+
+/**
+  * Calls task(i) for every i in [0, taskCount) and returns once all of them
+  * have completed. The calling thread takes part as one of the workers.
+  */
+void WorkStealingPool::run(int taskCount, const std::function<void(int)>& task) const
+{
+    if (taskCount <= 0)
+        return;
+
+    const int workerCount = qMin(m_threadCount, taskCount);
+    if (workerCount == 1) {
+        for (int i = 0; i < taskCount; i++)
+            task(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> runGuard(m_workers->runLock);
+    if (m_workers->threads.empty()) {
+        m_workers->ranges = std::vector<WorkRange>(size_t(m_threadCount));
+        m_workers->threads.reserve(m_threadCount - 1);
+        for (int worker = 1; worker < m_threadCount; worker++)
+            m_workers->threads.emplace_back(&Workers::loop, m_workers, worker);
+    }
+
+    Job job(taskCount, workerCount, m_workers->ranges.data(), task);
+    {
+        std::lock_guard<std::mutex> guard(m_workers->lock);
+        m_workers->job = &job;
+        m_workers->busyCount = workerCount - 1;
+        m_workers->jobNumber++;
+    }
+    m_workers->jobStarted.notify_all();
+
+    work(job, 0);
+
+    std::unique_lock<std::mutex> guard(m_workers->lock);
+    m_workers->jobFinished.wait(guard, [this]() { return m_workers->busyCount == 0; });
+    m_workers->job = NULL;
+}
@@ -0,0 +1,34 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <functional>
+
+#include <QtGlobal>
+
+// A fixed set of worker threads that run batches of indexed tasks. The
+// threads are started by the first batch that needs them and then wait for
+// the next one, until the pool is destroyed. A pool runs one batch at a
+// time; a task must not run a batch on its own pool. A pool of one thread
+// never starts any, runs its batches on the calling thread and can be
+// shared by several threads.
+class WorkStealingPool
+{
+public:
+    // A threadCount of 0 uses one thread per available core.
+    explicit WorkStealingPool(int threadCount = 0);
+    ~WorkStealingPool();
+
+    int threadCount() const { return m_threadCount; }
+
+    void run(int taskCount, const std::function<void(int)>& task) const;
+
+private:
+    Q_DISABLE_COPY(WorkStealingPool)
+
+    struct Workers;
+
+    int m_threadCount;
+    Workers *m_workers;
+};
+
+#endif // WORKSTEALINGPOOL_H
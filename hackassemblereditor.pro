@@ -6,29 +6,39 @@
 
 QT += core gui widgets
 
-QMAKE_CXXFLAGS += -std=c++11
-QMAKE_CXXFLAGS += -std=gnu++11
+QMAKE_CXXFLAGS += -std=c++14
+QMAKE_CXXFLAGS += -std=gnu++14
 
 TARGET = hackassemblereditor
 TEMPLATE = app
 
+include(hackassembler/hackassembler.pri)
+include(hackemulator/hackemulator.pri)
+
 SOURCES += main.cpp \
-    hackassembler/assembler.cpp \
-    hackassembler/code.cpp \
-    hackassembler/parser.cpp \
-    hackassembler/symboltable.cpp \
     helpers/assemblercontroller.cpp \
+    helpers/assemblerworker.cpp \
+    helpers/emulatorcontroller.cpp \
+    helpers/emulatorworker.cpp \
+    helpers/errorlistmodel.cpp \
     helpers/hacksyntaxhighlighter.cpp \
+    helpers/referencecodemodel.cpp \
+    helpers/translatedcodemodel.cpp \
     ui/aboutdialog.cpp \
     ui/hackassemblereditor.cpp
 
 HEADERS  += \
-    hackassembler/assembler.h \
-    hackassembler/code.h \
-    hackassembler/parser.h \
-    hackassembler/symboltable.h \
     helpers/assemblercontroller.h \
+    helpers/assemblerworker.h \
+    helpers/assemblysnapshot.h \
+    helpers/emulatorcontroller.h \
+    helpers/emulatorsnapshot.h \
+    helpers/emulatorworker.h \
+    helpers/errorlistmodel.h \
     helpers/hacksyntaxhighlighter.h \
+    helpers/referencecodemodel.h \
+    helpers/translatedcodemodel.h \
+    helpers/triplebuffer.h \
     ui/aboutdialog.h \
     ui/hackassemblereditor.h
 
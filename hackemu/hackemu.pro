@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# hackemu: headless Hack CPU emulator.
+#
+#-------------------------------------------------
+
+QT += core
+QT -= gui
+
+QMAKE_CXXFLAGS += -std=c++14
+QMAKE_CXXFLAGS += -std=gnu++14
+
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = hackemu
+TEMPLATE = app
+
+include(../hackassembler/hackassembler.pri)
+include(../hackemulator/hackemulator.pri)
+
+SOURCES += main.cpp
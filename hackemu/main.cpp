@@ -0,0 +1,322 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <random>
+
+#include "hackassembler/assembler.h"
+#include "hackassembler/hackbinaryfile.h"
+#include "hackemulator/hackcpu.h"
+#include "hackemulator/hackjit.h"
+
+static const int MAX_REPORTED_ERRORS = 100;
+
+static const int SELFTEST_PROGRAMS = 3000;
+static const int SELFTEST_SLICES = 40;
+
+// Multiplies by repeated addition and stores the products over the
+// screen, then starts over, so every kind of instruction keeps running.
+static const char BENCHMARK_SOURCE[] =
+    "(RESTART)\n"
+    "    @SCREEN\n"
+    "    D=A\n"
+    "    @ptr\n"
+    "    M=D\n"
+    "(FILL)\n"
+    "    @R2\n"
+    "    M=0\n"
+    "    @17\n"
+    "    D=A\n"
+    "    @count\n"
+    "    M=D\n"
+    "(MULTIPLY)\n"
+    "    @ptr\n"
+    "    D=M\n"
+    "    @R2\n"
+    "    M=D+M\n"
+    "    @count\n"
+    "    MD=M-1\n"
+    "    @MULTIPLY\n"
+    "    D;JGT\n"
+    "    @R2\n"
+    "    D=M\n"
+    "    @ptr\n"
+    "    A=M\n"
+    "    M=D\n"
+    "    @ptr\n"
+    "    MD=M+1\n"
+    "    @KBD\n"
+    "    D=D-A\n"
+    "    @FILL\n"
+    "    D;JLT\n"
+    "    @RESTART\n"
+    "    0;JMP\n";
+
+static bool assembleSource(const QString& source, const QString& sourcePath, QVector<quint16> *program, QTextStream& err)
+{
+    Assembler assembler;
+    assembler.setSourceCode(source);
+    assembler.translateAll();
+    const Assembler::ErrorList& errors = assembler.errors();
+    for (int i = 0; i < qMin(errors.size(), MAX_REPORTED_ERRORS); i++) {
+        const Assembler::Error& error = errors.at(i);
+        err << sourcePath << ":" << error.line + 1 << ": " << assembler.errorMessage(error) << endl;
+    }
+    if (errors.size() > MAX_REPORTED_ERRORS)
+        err << sourcePath << ": " << errors.size() - MAX_REPORTED_ERRORS << " more errors" << endl;
+    *program = assembler.binaryCode();
+    return errors.isEmpty();
+}
+
+/**
+  * .hack files are loaded as they are; anything else is assembled first.
+  */
+static bool loadProgram(const QString& path, QVector<quint16> *program, QTextStream& err)
+{
+    if (path.endsWith(".hack", Qt::CaseInsensitive)) {
+        HackBinaryFile binaryFile;
+        if (!binaryFile.open(path)) {
+            err << path << ": cannot open file" << endl;
+            return false;
+        }
+        program->resize(binaryFile.rowCount());
+        QVector<int> invalidRows;
+        binaryFile.decodeInstructions(0, binaryFile.rowCount(), program->data(), &invalidRows);
+        for (int i = 0; i < qMin(invalidRows.size(), MAX_REPORTED_ERRORS); i++)
+            err << path << ": instruction " << invalidRows.at(i) + 1 << " is not 16 binary digits" << endl;
+        return invalidRows.isEmpty();
+    }
+
+    QFile sourceFile(path);
+    if (!sourceFile.open(QFile::ReadOnly | QFile::Text)) {
+        err << path << ": " << sourceFile.errorString() << endl;
+        return false;
+    }
+    return assembleSource(QTextStream(&sourceFile).readAll(), path, program, err);
+}
+
+/**
+  * Runs until the program halts or count instructions have run, and
+  * reports the instruction rate. Decoding the program is not measured.
+  */
+static void runProgram(HackCpu& cpu, qint64 count, QTextStream& out)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 instructionCount = cpu.run(count);
+    const double seconds = qMax(timer.nsecsElapsed(), qint64(1)) / 1e9;
+
+    out << QString("Ran %1 instructions in %2 ms, %3 million instructions/s (%4)\n")
+           .arg(instructionCount).arg(seconds * 1e3, 0, 'f', 1)
+           .arg(instructionCount / seconds / 1e6, 0, 'f', 1)
+           .arg(cpu.isJitEnabled() ? "JIT" : "interpreter");
+    out << QString("%1 at PC=%2, A=%3, D=%4\n")
+           .arg(cpu.isHalted() ? "Halted" : "Stopped").arg(cpu.pc())
+           .arg(cpu.a()).arg(qint16(cpu.d()));
+}
+
+/**
+  * A random program: mostly C-instructions with any bits, documented or
+  * not, and A-instructions that load addresses around the program, so that
+  * its jumps form loops. Some end in a halt loop.
+  */
+static QVector<quint16> randomProgram(std::mt19937& random)
+{
+    const int size = 1 + random() % 200;
+    QVector<quint16> program;
+    program.reserve(size + 2);
+    for (int i = 0; i < size; i++) {
+        switch (random() % 5) {
+        case 0:
+        case 1:
+            program.append(quint16(random() % (size + 8)));
+            break;
+        case 2:
+            program.append(quint16(0x8000 | (random() & 0x7fff)));
+            break;
+        default:
+            program.append(quint16(0xe000 | (random() & 0x1fff)));
+            break;
+        }
+    }
+    if (random() % 3 == 0) {
+        program.append(quint16(program.size()));
+        program.append(0xea87);     // 0;JMP
+    }
+    return program;
+}
+
+static bool isSameState(const HackCpu& interpreter, const HackCpu& jit)
+{
+    if (interpreter.a() != jit.a() || interpreter.d() != jit.d() || interpreter.pc() != jit.pc()
+            || interpreter.instructionCount() != jit.instructionCount()
+            || interpreter.stopReason() != jit.stopReason())
+        return false;
+    if (interpreter.stopReason() == HackCpu::WATCHPOINT
+            && interpreter.watchpointAddress() != jit.watchpointAddress())
+        return false;
+    return interpreter.ramContents() == jit.ramContents();
+}
+
+/**
+  * Runs random programs on the interpreter and on the JIT side by side, in
+  * slices of random length, setting and clearing the same breakpoints and
+  * watchpoints on both between slices. Every slice has to end with the
+  * same registers, RAM, instruction count and stop reason on both, and
+  * some of the instructions have to have run natively.
+  */
+static bool runSelfTest(QTextStream& out, QTextStream& err)
+{
+    if (!HackJit::isSupported()) {
+        out << "The JIT is not supported on this host, there is nothing to compare it with" << endl;
+        return true;
+    }
+
+    std::mt19937 random(11);
+    int breakpointStops = 0;
+    int watchpointStops = 0;
+    int halts = 0;
+    qint64 nativeInstructions = 0;
+    for (int programNumber = 0; programNumber < SELFTEST_PROGRAMS; programNumber++) {
+        const QVector<quint16> program = randomProgram(random);
+        HackCpu interpreter;
+        interpreter.setJitEnabled(false);
+        HackCpu jit;
+        if (!jit.isJitEnabled()) {
+            err << "The JIT is supported on this host but could not be enabled" << endl;
+            return false;
+        }
+        interpreter.loadProgram(program);
+        jit.loadProgram(program);
+        for (int address = 0; address < 64; address++) {
+            const quint16 value = quint16(random());
+            interpreter.setRam(address, value);
+            jit.setRam(address, value);
+        }
+
+        for (int slice = 0; slice < SELFTEST_SLICES; slice++) {
+            if (random() % 6 == 0) {
+                const int address = random() % (program.size() + 2);
+                const bool enabled = random() % 2;
+                interpreter.setBreakpoint(address, enabled);
+                jit.setBreakpoint(address, enabled);
+            } else if (random() % 5 == 0) {
+                const int address = random() % (program.size() + 16);
+                const bool enabled = random() % 3 != 0;
+                interpreter.setWatchpoint(address, enabled);
+                jit.setWatchpoint(address, enabled);
+            }
+
+            const qint64 count = random() % 3000;
+            const qint64 interpretedCount = interpreter.run(count);
+            const qint64 jitCount = jit.run(count);
+            if (interpretedCount != jitCount || !isSameState(interpreter, jit)) {
+                err << QString("Program %1, slice %2: the interpreter stopped at PC=%3, A=%4, D=%5 "
+                               "after %6 instructions with stop reason %7, the JIT at PC=%8, A=%9, "
+                               "D=%10 after %11 instructions with stop reason %12%13\n")
+                       .arg(programNumber).arg(slice)
+                       .arg(interpreter.pc()).arg(interpreter.a()).arg(interpreter.d())
+                       .arg(interpreter.instructionCount()).arg(interpreter.stopReason())
+                       .arg(jit.pc()).arg(jit.a()).arg(jit.d())
+                       .arg(jit.instructionCount()).arg(jit.stopReason())
+                       .arg(interpreter.ramContents() == jit.ramContents() ? "" : ", and different RAM");
+                return false;
+            }
+
+            if (interpreter.stopReason() == HackCpu::BREAKPOINT) {
+                breakpointStops++;
+            } else if (interpreter.stopReason() == HackCpu::WATCHPOINT) {
+                watchpointStops++;
+            } else if (interpreter.isHalted()) {
+                halts++;
+                break;
+            }
+        }
+        nativeInstructions += jit.nativeInstructionCount();
+    }
+
+    // Agreeing proves nothing if the JIT never got to run anything.
+    if (nativeInstructions == 0) {
+        err << "The JIT did not run any instructions natively" << endl;
+        return false;
+    }
+    out << QString("The JIT agreed with the interpreter on %1 programs, through %2 breakpoint stops, "
+                   "%3 watchpoint stops and %4 halts, running %L5 instructions natively\n")
+           .arg(SELFTEST_PROGRAMS).arg(breakpointStops).arg(watchpointStops).arg(halts)
+           .arg(nativeInstructions);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("github.com/setanta");
+    QCoreApplication::setApplicationName("hackemu");
+
+    QCommandLineParser cmdLine;
+    cmdLine.setApplicationDescription("Runs a Hack program, given as a .hack or .asm file, on the Hack CPU.");
+    cmdLine.addHelpOption();
+    cmdLine.addPositionalArgument("program", "Hack binary (.hack) or assembly (.asm) file.", "<program>");
+
+    QCommandLineOption limitOption(QStringList() << "n" << "limit",
+                                   "Stop after <count> instructions if the program has not halted.",
+                                   "count", "1000000000");
+    QCommandLineOption ramOption(QStringList() << "r" << "ram",
+                                 "Print RAM[<first>] to RAM[<last>] when the program stops.", "first-last");
+    QCommandLineOption benchmarkOption(QStringList() << "b" << "benchmark",
+                                       "Run a built-in program for <count> instructions instead, and report the rate.",
+                                       "count");
+    QCommandLineOption interpretOption(QStringList() << "i" << "interpret",
+                                       "Only use the interpreter, without translating hot code to native code.");
+    QCommandLineOption selfTestOption("selftest",
+                                      "Run random programs on the interpreter and the JIT, and check that they agree.");
+    cmdLine.addOption(limitOption);
+    cmdLine.addOption(ramOption);
+    cmdLine.addOption(benchmarkOption);
+    cmdLine.addOption(interpretOption);
+    cmdLine.addOption(selfTestOption);
+    cmdLine.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (cmdLine.isSet(selfTestOption))
+        return runSelfTest(out, err) ? 0 : 1;
+
+    QVector<quint16> program;
+    qint64 count = cmdLine.value(limitOption).toLongLong();
+    if (cmdLine.isSet(benchmarkOption)) {
+        if (!assembleSource(QString::fromLatin1(BENCHMARK_SOURCE), "benchmark", &program, err))
+            return 1;
+        count = cmdLine.value(benchmarkOption).toLongLong();
+    } else {
+        const QStringList arguments = cmdLine.positionalArguments();
+        if (arguments.size() != 1) {
+            err << "hackemu: expected one program file" << endl;
+            return 2;
+        }
+        if (!loadProgram(arguments.first(), &program, err))
+            return 1;
+    }
+    if (program.size() > HackCpu::ROM_SIZE) {
+        err << "hackemu: the program has " << program.size() << " instructions, more than the "
+            << HackCpu::ROM_SIZE << " that fit in ROM" << endl;
+        return 1;
+    }
+
+    HackCpu cpu;
+    cpu.setJitEnabled(!cmdLine.isSet(interpretOption));
+    cpu.loadProgram(program);
+    runProgram(cpu, qMax(count, qint64(0)), out);
+
+    if (cmdLine.isSet(ramOption)) {
+        const QStringList range = cmdLine.value(ramOption).split('-');
+        const int first = range.first().toInt();
+        const int last = range.last().toInt();
+        for (int address = first; address <= last && address < HackCpu::RAM_SIZE; address++)
+            out << QString("RAM[%1] = %2\n").arg(address).arg(qint16(cpu.ram(address)));
+    }
+
+    return 0;
+}
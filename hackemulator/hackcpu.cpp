@@ -0,0 +1,419 @@
+#include "hackcpu.h"
+#include "hackjit.h"
+
+// GCC and Clang can jump through a table of label addresses, which gives
+// every handler a dispatch branch of its own. Other compilers get a switch.
+#if defined(Q_CC_GNU)
+#  define HACKCPU_COMPUTED_GOTO
+#endif
+
+const int HackCpu::ROM_SIZE = 32768;
+const int HackCpu::RAM_SIZE = 32768;
+const int HackCpu::ADDRESS_MASK = 0x7fff;
+
+HackCpu::HackCpu()
+    : m_decodedRom(ROM_SIZE, decode(0)),
+      m_rom(m_decodedRom),
+      m_ram(RAM_SIZE, 0),
+      m_breakpoints(ROM_SIZE, 0),
+      m_watchpoints(RAM_SIZE, 0),
+      m_watchpointCount(0),
+      m_watchpointAddress(-1),
+      m_a(0),
+      m_d(0),
+      m_pc(0),
+      m_stopReason(BUDGET),
+      m_instructionCount(0),
+      m_nativeInstructionCount(0),
+      m_jit(NULL)
+{
+    setJitEnabled(true);
+}
+
+HackCpu::~HackCpu()
+{
+    delete m_jit;
+}
+
+/**
+ * Words past the program decode like 0, which is "@0", as in the hardware.
+ */
+void HackCpu::loadProgram(const QVector<quint16>& program)
+{
+    const int size = qMin(program.size(), ROM_SIZE);
+    Op *decodedRom = m_decodedRom.data();
+    for (int address = 0; address < size; address++)
+        decodedRom[address] = decode(program.at(address));
+    const Op empty = decode(0);
+    for (int address = size; address < ROM_SIZE; address++)
+        decodedRom[address] = empty;
+    decodeHaltLoops();
+
+    m_rom = m_decodedRom;
+    Op *rom = m_rom.data();
+    for (int address = 0; address < ROM_SIZE; address++) {
+        if (m_breakpoints.at(address))
+            rom[address].handler = STOP;
+    }
+    if (m_jit)
+        m_jit->clear();
+    reset();
+}
+
+void HackCpu::reset()
+{
+    m_a = 0;
+    m_d = 0;
+    m_pc = 0;
+    m_stopReason = BUDGET;
+    m_watchpointAddress = -1;
+    m_instructionCount = 0;
+    m_nativeInstructionCount = 0;
+}
+
+void HackCpu::clearRam()
+{
+    m_ram.fill(0);
+}
+
+/**
+ * Does nothing where the host cannot run translated code.
+ */
+void HackCpu::setJitEnabled(bool enabled)
+{
+    if (enabled == (m_jit != NULL) || (enabled && !HackJit::isSupported()))
+        return;
+    if (!enabled) {
+        delete m_jit;
+        m_jit = NULL;
+        return;
+    }
+    m_jit = new HackJit;
+    if (!m_jit->isValid()) {
+        delete m_jit;
+        m_jit = NULL;
+    }
+}
+
+/**
+ * Translations that contain the instruction are dropped, so that the JIT
+ * ends its blocks before it.
+ */
+void HackCpu::setBreakpoint(int address, bool enabled)
+{
+    address &= ADDRESS_MASK;
+    if (enabled == bool(m_breakpoints.at(address)))
+        return;
+    m_breakpoints[address] = enabled;
+    m_rom[address].handler = enabled ? quint8(STOP) : m_decodedRom.at(address).handler;
+    if (m_jit)
+        m_jit->clear();
+}
+
+/**
+ * Translated code only checks for watchpoints while there are any.
+ */
+void HackCpu::setWatchpoint(int address, bool enabled)
+{
+    address &= ADDRESS_MASK;
+    if (enabled == bool(m_watchpoints.at(address)))
+        return;
+    m_watchpoints[address] = enabled;
+    m_watchpointCount += enabled ? 1 : -1;
+    if (m_jit)
+        m_jit->setWatching(m_watchpointCount > 0);
+}
+
+/**
+ * Breakpoints stop a run before their instruction, so a run that starts on
+ * one takes its instruction from the ROM as decoded first.
+ */
+qint64 HackCpu::run(qint64 count)
+{
+    m_stopReason = BUDGET;
+    if (count <= 0)
+        return 0;
+
+    qint64 executed = 0;
+    if (m_rom.at(m_pc).handler == STOP) {
+        executed = interpret(m_decodedRom.constData(), 1);
+        if (executed == count || m_stopReason != BUDGET)
+            return executed;
+    }
+    return executed + (m_jit ? runWithJit(count - executed) : interpret(m_rom.constData(), count - executed));
+}
+
+/**
+ * Goes block by block: translated blocks run natively, chained to each
+ * other, as long as the budget covers them; the others are interpreted and
+ * counted, so that the JIT translates them once they are hot.
+ */
+qint64 HackCpu::runWithJit(qint64 count)
+{
+    const Op *rom = m_rom.constData();
+    qint64 remaining = count;
+    while (remaining > 0) {
+        const int length = m_jit->blockLength(rom, m_pc);
+        const void *code = m_jit->code(m_pc);
+        if (code && remaining >= length) {
+            const qint64 budget = remaining;
+            int watchpointAddress = -1;
+            m_pc = m_jit->run(code, m_ram.data(), m_watchpoints.constData(), &m_a, &m_d, &remaining,
+                              &watchpointAddress);
+            m_instructionCount += budget - remaining;
+            m_nativeInstructionCount += budget - remaining;
+            if (watchpointAddress >= 0) {
+                m_stopReason = WATCHPOINT;
+                m_watchpointAddress = watchpointAddress;
+                break;
+            }
+            continue;
+        }
+        m_jit->countExecution(rom, m_pc);
+        remaining -= interpret(rom, qMin(remaining, qint64(length)));
+        if (m_stopReason != BUDGET)
+            break;
+    }
+    return count - remaining;
+}
+
+/**
+ * Registers live in locals for the whole run. Each handler computes its ALU
+ * function and the shared tail stores the result and picks the next PC,
+ * with M and the jump target taken from A as it was before the store.
+ * A write to a watched word makes its instruction the last of the budget,
+ * so that the check stays off the path of every other instruction.
+ */
+qint64 HackCpu::interpret(const Op *rom, qint64 count)
+{
+    m_stopReason = BUDGET;
+    if (count <= 0)
+        return 0;
+
+    quint16 *ram = m_ram.data();
+    const quint8 *watchpoints = m_watchpoints.constData();
+    quint16 a = m_a;
+    quint16 d = m_d;
+    int pc = m_pc;
+    qint64 remaining = count;
+    qint64 remainingAfterWatchpoint = 0;
+    const Op *op;
+    quint16 out;
+
+#ifdef HACKCPU_COMPUTED_GOTO
+#  define HANDLER(name) name##_handler
+#  define NEXT() do { op = rom + pc; goto *HANDLER_LABELS[op->handler]; } while (0)
+    static const void *const HANDLER_LABELS[HANDLER_COUNT] = {
+        &&LOAD_handler, &&HALT_handler, &&STOP_handler, &&GENERIC_handler,
+        &&ZERO_handler, &&ONE_handler, &&MINUS_ONE_handler,
+        &&D_handler, &&A_handler, &&M_handler,
+        &&NOT_D_handler, &&NOT_A_handler, &&NOT_M_handler,
+        &&NEG_D_handler, &&NEG_A_handler, &&NEG_M_handler,
+        &&D_PLUS_1_handler, &&A_PLUS_1_handler, &&M_PLUS_1_handler,
+        &&D_MINUS_1_handler, &&A_MINUS_1_handler, &&M_MINUS_1_handler,
+        &&D_PLUS_A_handler, &&D_PLUS_M_handler, &&D_MINUS_A_handler,
+        &&D_MINUS_M_handler, &&A_MINUS_D_handler, &&M_MINUS_D_handler,
+        &&D_AND_A_handler, &&D_AND_M_handler, &&D_OR_A_handler, &&D_OR_M_handler
+    };
+    NEXT();
+#else
+#  define HANDLER(name) case name
+#  define NEXT() continue
+    for (;;) {
+        op = rom + pc;
+        switch (op->handler) {
+#endif
+
+    HANDLER(LOAD):
+        a = op->value;
+        pc = (pc + 1) & ADDRESS_MASK;
+        if (--remaining == 0)
+            goto done;
+        NEXT();
+
+    HANDLER(HALT):
+        if ((a & ADDRESS_MASK) == pc - 1) {
+            m_stopReason = HALTED;
+            goto done;
+        }
+        pc = a & ADDRESS_MASK;
+        if (--remaining == 0)
+            goto done;
+        NEXT();
+
+    HANDLER(STOP):
+        m_stopReason = BREAKPOINT;
+        goto done;
+
+    HANDLER(GENERIC): out = alu(op->value, d, a, ram[a & ADDRESS_MASK]); goto store;
+    HANDLER(ZERO): out = 0; goto store;
+    HANDLER(ONE): out = 1; goto store;
+    HANDLER(MINUS_ONE): out = 0xffff; goto store;
+    HANDLER(D): out = d; goto store;
+    HANDLER(A): out = a; goto store;
+    HANDLER(M): out = ram[a & ADDRESS_MASK]; goto store;
+    HANDLER(NOT_D): out = quint16(~d); goto store;
+    HANDLER(NOT_A): out = quint16(~a); goto store;
+    HANDLER(NOT_M): out = quint16(~ram[a & ADDRESS_MASK]); goto store;
+    HANDLER(NEG_D): out = quint16(0 - d); goto store;
+    HANDLER(NEG_A): out = quint16(0 - a); goto store;
+    HANDLER(NEG_M): out = quint16(0 - ram[a & ADDRESS_MASK]); goto store;
+    HANDLER(D_PLUS_1): out = quint16(d + 1); goto store;
+    HANDLER(A_PLUS_1): out = quint16(a + 1); goto store;
+    HANDLER(M_PLUS_1): out = quint16(ram[a & ADDRESS_MASK] + 1); goto store;
+    HANDLER(D_MINUS_1): out = quint16(d - 1); goto store;
+    HANDLER(A_MINUS_1): out = quint16(a - 1); goto store;
+    HANDLER(M_MINUS_1): out = quint16(ram[a & ADDRESS_MASK] - 1); goto store;
+    HANDLER(D_PLUS_A): out = quint16(d + a); goto store;
+    HANDLER(D_PLUS_M): out = quint16(d + ram[a & ADDRESS_MASK]); goto store;
+    HANDLER(D_MINUS_A): out = quint16(d - a); goto store;
+    HANDLER(D_MINUS_M): out = quint16(d - ram[a & ADDRESS_MASK]); goto store;
+    HANDLER(A_MINUS_D): out = quint16(a - d); goto store;
+    HANDLER(M_MINUS_D): out = quint16(ram[a & ADDRESS_MASK] - d); goto store;
+    HANDLER(D_AND_A): out = d & a; goto store;
+    HANDLER(D_AND_M): out = d & ram[a & ADDRESS_MASK]; goto store;
+    HANDLER(D_OR_A): out = d | a; goto store;
+    HANDLER(D_OR_M): out = d | ram[a & ADDRESS_MASK]; goto store;
+
+#ifndef HACKCPU_COMPUTED_GOTO
+        default:
+            Q_UNREACHABLE();
+        }
+#endif
+
+    store:
+        {
+            const int address = a & ADDRESS_MASK;
+            const quint8 flags = op->flags;
+            if (flags & DEST_M) {
+                ram[address] = out;
+                // Leaves this instruction the last one of the budget.
+                if (Q_UNLIKELY(watchpoints[address])) {
+                    m_stopReason = WATCHPOINT;
+                    m_watchpointAddress = address;
+                    remainingAfterWatchpoint = remaining - 1;
+                    remaining = 1;
+                }
+            }
+            if (flags & DEST_A)
+                a = out;
+            if (flags & DEST_D)
+                d = out;
+            pc = (pc + 1) & ADDRESS_MASK;
+            if (flags & (JLT | JEQ | JGT)) {
+                const qint16 value = qint16(out);
+                const quint8 condition = value < 0 ? JLT : value == 0 ? JEQ : JGT;
+                if (flags & condition)
+                    pc = address;
+            }
+        }
+        if (--remaining == 0)
+            goto done;
+        NEXT();
+
+#ifndef HACKCPU_COMPUTED_GOTO
+    }
+#endif
+#undef HANDLER
+#undef NEXT
+
+done:
+    if (m_stopReason == WATCHPOINT)
+        remaining = remainingAfterWatchpoint;
+    m_a = a;
+    m_d = d;
+    m_pc = pc;
+    const qint64 executed = count - remaining;
+    m_instructionCount += executed;
+    return executed;
+}
+
+quint16 HackCpu::alu(uint comp, quint16 d, quint16 a, quint16 m)
+{
+    quint16 x = d;
+    quint16 y = (comp & 0x40) ? m : a;
+    if (comp & 0x20)
+        x = 0;
+    if (comp & 0x10)
+        x = quint16(~x);
+    if (comp & 0x08)
+        y = 0;
+    if (comp & 0x04)
+        y = quint16(~y);
+    quint16 out = (comp & 0x02) ? quint16(x + y) : quint16(x & y);
+    if (comp & 0x01)
+        out = quint16(~out);
+    return out;
+}
+
+/**
+ * C-instructions keep their low six bits as flags: the jump bits are the
+ * JLT, JEQ and JGT conditions and the dest bits M, D and A. Like the
+ * hardware, the two bits after the leading 1 are ignored.
+ */
+HackCpu::Op HackCpu::decode(quint16 instruction)
+{
+    Op op;
+    if (!(instruction & 0x8000)) {
+        op.value = instruction;
+        op.handler = LOAD;
+        op.flags = 0;
+        return op;
+    }
+    const uint comp = (instruction >> 6) & 0x7f;
+    op.value = quint16(comp);
+    op.handler = compHandler(comp);
+    op.flags = quint8(instruction & 0x3f);
+    return op;
+}
+
+HackCpu::Handler HackCpu::compHandler(uint comp)
+{
+    switch (comp) {
+    case 0b0101010: return ZERO;
+    case 0b0111111: return ONE;
+    case 0b0111010: return MINUS_ONE;
+    case 0b0001100: return D;
+    case 0b0110000: return A;
+    case 0b1110000: return M;
+    case 0b0001101: return NOT_D;
+    case 0b0110001: return NOT_A;
+    case 0b1110001: return NOT_M;
+    case 0b0001111: return NEG_D;
+    case 0b0110011: return NEG_A;
+    case 0b1110011: return NEG_M;
+    case 0b0011111: return D_PLUS_1;
+    case 0b0110111: return A_PLUS_1;
+    case 0b1110111: return M_PLUS_1;
+    case 0b0001110: return D_MINUS_1;
+    case 0b0110010: return A_MINUS_1;
+    case 0b1110010: return M_MINUS_1;
+    case 0b0000010: return D_PLUS_A;
+    case 0b1000010: return D_PLUS_M;
+    case 0b0010011: return D_MINUS_A;
+    case 0b1010011: return D_MINUS_M;
+    case 0b0000111: return A_MINUS_D;
+    case 0b1000111: return M_MINUS_D;
+    case 0b0000000: return D_AND_A;
+    case 0b1000000: return D_AND_M;
+    case 0b0010101: return D_OR_A;
+    case 0b1010101: return D_OR_M;
+    default: return GENERIC;
+    }
+}
+
+/**
+ * "@k" at address k followed by an unconditional jump that stores nothing
+ * spins forever; its jump becomes a HALT, which stops run() when it is
+ * reached with A still at k, and otherwise just jumps.
+ */
+void HackCpu::decodeHaltLoops()
+{
+    Op *rom = m_decodedRom.data();
+    for (int address = 1; address < ROM_SIZE; address++) {
+        const Op& load = rom[address - 1];
+        if (rom[address].handler != LOAD && rom[address].flags == (JLT | JEQ | JGT)
+                && load.handler == LOAD && load.value == address - 1)
+            rom[address].handler = HALT;
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef HACKCPU_H
+#define HACKCPU_H
+
+#include <QVector>
+
+class HackJit;
+
+// The Hack computer: 32K words of ROM and RAM and the A, D and PC
+// registers. Every ROM word is decoded once, when the program is loaded,
+// into an Op naming the handler that runs it; running dispatches straight
+// from one handler to the next. Addresses wrap at 32K, so no access needs
+// a bounds check. Where HackJit is supported, blocks that run often are
+// translated into native code, which runs them with the same results.
+// Breakpoints replace the handler of their instruction, and watched RAM
+// words are flagged in a table read on every write to M, so neither needs
+// a check of its own on the instructions that do not hit them.
+class HackCpu
+{
+public:
+    static const int ROM_SIZE;
+    static const int RAM_SIZE;
+
+    // Why the last run() ended.
+    enum StopReason {
+        BUDGET,         // It ran all the instructions it was given
+        HALTED,         // At a halt loop, "(END) @END 0;JMP"
+        BREAKPOINT,     // Before an instruction with a breakpoint
+        WATCHPOINT      // After an instruction wrote to a watched RAM word
+    };
+
+    HackCpu();
+    ~HackCpu();
+
+    // Loads the program at address 0 and clears the rest of the ROM, then
+    // resets the registers. RAM, breakpoints and watchpoints are kept.
+    void loadProgram(const QVector<quint16>& program);
+    void reset();
+    void clearRam();
+
+    // Executes up to count instructions and returns how many ran. Stops
+    // early for the other stop reasons. A run that starts on a breakpoint
+    // runs its instruction.
+    qint64 run(qint64 count);
+    bool step() { return run(1) == 1; }
+    StopReason stopReason() const { return m_stopReason; }
+    bool isHalted() const { return m_stopReason == HALTED; }
+
+    void setBreakpoint(int address, bool enabled);
+    bool hasBreakpoint(int address) const { return m_breakpoints.at(address & ADDRESS_MASK); }
+    void setWatchpoint(int address, bool enabled);
+    bool hasWatchpoint(int address) const { return m_watchpoints.at(address & ADDRESS_MASK); }
+    // The RAM word whose write stopped the last run at a watchpoint.
+    int watchpointAddress() const { return m_watchpointAddress; }
+
+    // On by default where the host supports it.
+    bool isJitEnabled() const { return m_jit != NULL; }
+    void setJitEnabled(bool enabled);
+
+    quint16 a() const { return m_a; }
+    quint16 d() const { return m_d; }
+    int pc() const { return m_pc; }
+    qint64 instructionCount() const { return m_instructionCount; }
+    // Of those, the instructions run as translated code.
+    qint64 nativeInstructionCount() const { return m_nativeInstructionCount; }
+
+    quint16 ram(int address) const { return m_ram.at(address & ADDRESS_MASK); }
+    void setRam(int address, quint16 value) { m_ram[address & ADDRESS_MASK] = value; }
+    const QVector<quint16>& ramContents() const { return m_ram; }
+
+    // The ALU on comp bits "a c1..c6", as the hardware computes it.
+    static quint16 alu(uint comp, quint16 d, quint16 a, quint16 m);
+
+private:
+    Q_DISABLE_COPY(HackCpu)
+    friend class HackJit;
+
+    static const int ADDRESS_MASK;
+
+    // One per ALU function of the documented comp mnemonics, plus LOAD for
+    // A-instructions, HALT for the jump of a halt loop, STOP for
+    // instructions with a breakpoint and GENERIC for the undocumented comp
+    // bits.
+    enum Handler : quint8 {
+        LOAD, HALT, STOP, GENERIC,
+        ZERO, ONE, MINUS_ONE,
+        D, A, M, NOT_D, NOT_A, NOT_M, NEG_D, NEG_A, NEG_M,
+        D_PLUS_1, A_PLUS_1, M_PLUS_1, D_MINUS_1, A_MINUS_1, M_MINUS_1,
+        D_PLUS_A, D_PLUS_M, D_MINUS_A, D_MINUS_M, A_MINUS_D, M_MINUS_D,
+        D_AND_A, D_AND_M, D_OR_A, D_OR_M,
+        HANDLER_COUNT
+    };
+
+    enum Flag : quint8 {
+        JGT = 0x01,
+        JEQ = 0x02,
+        JLT = 0x04,
+        DEST_M = 0x08,
+        DEST_D = 0x10,
+        DEST_A = 0x20
+    };
+
+    // A decoded ROM word. value is the constant of LOAD and the comp bits of
+    // GENERIC; flags hold the jump and dest bits of C-instructions.
+    struct Op {
+        quint16 value;
+        quint8 handler;
+        quint8 flags;
+    };
+
+    qint64 interpret(const Op *rom, qint64 count);
+    qint64 runWithJit(qint64 count);
+
+    static Op decode(quint16 instruction);
+    static Handler compHandler(uint comp);
+    void decodeHaltLoops();
+
+    // The program as decoded, and as run, with its breakpoints.
+    QVector<Op> m_decodedRom;
+    QVector<Op> m_rom;
+    QVector<quint16> m_ram;
+    QVector<quint8> m_breakpoints;
+    QVector<quint8> m_watchpoints;
+    int m_watchpointCount;
+    int m_watchpointAddress;
+    quint16 m_a;
+    quint16 m_d;
+    int m_pc;
+    StopReason m_stopReason;
+    qint64 m_instructionCount;
+    qint64 m_nativeInstructionCount;
+    HackJit *m_jit;
+};
+
+#endif // HACKCPU_H
@@ -0,0 +1,12 @@
+# Hack CPU emulator core, shared by the editor and the hackemu command-line
+# tool. It only depends on QtCore.
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    $$PWD/hackcpu.cpp \
+    $$PWD/hackjit.cpp
+
+HEADERS += \
+    $$PWD/hackcpu.h \
+    $$PWD/hackjit.h
@@ -0,0 +1,420 @@
+#include <QPair>
+
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+
+#include "hackjit.h"
+
+#if defined(Q_PROCESSOR_X86_64) && (defined(Q_OS_UNIX) || defined(Q_OS_WIN))
+#  define HACKJIT_X86_64
+#  if defined(Q_OS_WIN)
+#    include <windows.h>
+#  else
+#    include <sys/mman.h>
+#  endif
+#endif
+
+const int HackJit::MAX_BLOCK_LENGTH = 256;
+const int HackJit::MAX_BLOCK_CODE_SIZE = 64 * 256 + 64;
+const int HackJit::CODE_CAPACITY = 8 * 1024 * 1024;
+const int HackJit::HOT_BLOCK_EXECUTIONS = 16;
+
+namespace {
+
+/**
+ * Register use of translated code, the same under the System V and the
+ * Windows calling conventions: rbx holds the State, r12 the RAM, r13d A,
+ * r14d D and r15 the remaining budget. Only the low 16 bits of A and D
+ * count. eax holds the ALU result, ecx the address in A and edx the ALU's
+ * y input; they also pass the next address to the exit routines.
+ */
+class CodeWriter
+{
+public:
+    explicit CodeWriter(uchar *code) : m_pos(code) {}
+
+    uchar *pos() const { return m_pos; }
+
+    void bytes(std::initializer_list<uchar> values)
+    {
+        for (uchar value : values)
+            *m_pos++ = value;
+    }
+    void int32(qint32 value)
+    {
+        std::memcpy(m_pos, &value, sizeof(value));
+        m_pos += sizeof(value);
+    }
+    // Emits the rel32 operand of a jump to target and returns its address.
+    uchar *rel32(const uchar *target)
+    {
+        uchar *operand = m_pos;
+        int32(qint32(target - (operand + 4)));
+        return operand;
+    }
+    // Points a rel32 operand emitted earlier at the current position.
+    void bind(uchar *operand) { CodeWriter(operand).rel32(m_pos); }
+
+    void movEaxImm(qint32 value) { bytes({ 0xb8 }); int32(value); }
+    void movEcxImm(qint32 value) { bytes({ 0xb9 }); int32(value); }
+    void movEdxImm(qint32 value) { bytes({ 0xba }); int32(value); }
+    void movR13dImm(qint32 value) { bytes({ 0x41, 0xbd }); int32(value); }
+    uchar *jmp(const uchar *target) { bytes({ 0xe9 }); return rel32(target); }
+    // cc is the low nibble of the 0x0f 0x8x opcode.
+    uchar *jcc(uchar cc, const uchar *target) { bytes({ 0x0f, uchar(0x80 | cc) }); return rel32(target); }
+
+private:
+    uchar *m_pos;
+};
+
+const uchar CC_E = 0x4;
+const uchar CC_NE = 0x5;
+const uchar CC_L = 0xc;
+const uchar CC_GE = 0xd;
+const uchar CC_LE = 0xe;
+const uchar CC_G = 0xf;
+
+// Indexed by the jump bits "j1 j2 j3", that is JLT JEQ JGT.
+const uchar JUMP_CONDITIONS[8] = { 0, CC_G, CC_E, CC_GE, CC_L, CC_NE, CC_LE, 0 };
+
+const int ADDRESS_MASK = 0x7fff;
+
+} // namespace
+
+bool HackJit::isSupported()
+{
+#ifdef HACKJIT_X86_64
+    return true;
+#else
+    return false;
+#endif
+}
+
+HackJit::HackJit()
+    : m_code(NULL),
+      m_codeSize(0),
+      m_runtimeSize(0),
+      m_watching(false),
+      m_enter(NULL),
+      m_exit(NULL),
+      m_lookup(NULL),
+      m_codeTable(HackCpu::ROM_SIZE, NULL),
+      m_blockLengths(HackCpu::ROM_SIZE, 0),
+      m_executions(HackCpu::ROM_SIZE, 0)
+{
+#ifdef HACKJIT_X86_64
+#  if defined(Q_OS_WIN)
+    m_code = static_cast<uchar *>(VirtualAlloc(NULL, CODE_CAPACITY, MEM_COMMIT | MEM_RESERVE,
+                                               PAGE_EXECUTE_READWRITE));
+#  else
+    void *code = mmap(NULL, CODE_CAPACITY, PROT_READ | PROT_WRITE | PROT_EXEC,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    m_code = code == MAP_FAILED ? NULL : static_cast<uchar *>(code);
+#  endif
+#endif
+    if (m_code)
+        emitRuntime();
+}
+
+HackJit::~HackJit()
+{
+#ifdef HACKJIT_X86_64
+    if (m_code) {
+#  if defined(Q_OS_WIN)
+        VirtualFree(m_code, 0, MEM_RELEASE);
+#  else
+        munmap(m_code, CODE_CAPACITY);
+#  endif
+    }
+#endif
+}
+
+void HackJit::clear()
+{
+    m_codeSize = m_runtimeSize;
+    m_codeTable.fill(NULL);
+    m_blockLengths.fill(0);
+    m_executions.fill(0);
+    m_pendingLinks.clear();
+}
+
+void HackJit::setWatching(bool watching)
+{
+    if (watching == m_watching)
+        return;
+    m_watching = watching;
+    clear();
+}
+
+/**
+ * A block takes in every instruction up to and including the first jump,
+ * or the first write to M while watching, but stops before the jump of a
+ * halt loop or a breakpoint, which are left to the interpreter. Execution
+ * can enter a block in its middle, which then starts a block of its own.
+ */
+int HackJit::blockLength(const HackCpu::Op *rom, int address)
+{
+    int length = m_blockLengths.at(address);
+    if (length > 0)
+        return length;
+
+    int end = address;
+    for (length = 0; length < MAX_BLOCK_LENGTH; length++, end = (end + 1) & ADDRESS_MASK) {
+        const HackCpu::Op& op = rom[end];
+        if (op.handler == HackCpu::HALT || op.handler == HackCpu::STOP) {
+            length = qMax(length, 1);
+            break;
+        }
+        const quint8 ends = m_watching ? (HackCpu::JLT | HackCpu::JEQ | HackCpu::JGT | HackCpu::DEST_M)
+                                       : (HackCpu::JLT | HackCpu::JEQ | HackCpu::JGT);
+        if (op.handler != HackCpu::LOAD && (op.flags & ends)) {
+            length++;
+            break;
+        }
+    }
+    m_blockLengths[address] = quint16(length);
+    return length;
+}
+
+void HackJit::countExecution(const HackCpu::Op *rom, int address)
+{
+    const quint8 handler = rom[address].handler;
+    if (!m_code || handler == HackCpu::HALT || handler == HackCpu::STOP || m_executions.at(address) == HOT_BLOCK_EXECUTIONS)
+        return;
+    if (++m_executions[address] == HOT_BLOCK_EXECUTIONS && m_codeSize + MAX_BLOCK_CODE_SIZE <= CODE_CAPACITY)
+        translate(rom, address);
+}
+
+int HackJit::run(const void *code, quint16 *ram, const quint8 *watches, quint16 *a, quint16 *d,
+                 qint64 *remaining, int *watchpointAddress) const
+{
+#ifdef HACKJIT_X86_64
+    typedef int (*EnterFunction)(State *state, const void *code);
+    State state;
+    state.ram = ram;
+    state.codeTable = m_codeTable.constData();
+    state.remaining = *remaining;
+    state.a = *a;
+    state.d = *d;
+    state.watchHit = -1;
+    state.watches = watches;
+    const int address = reinterpret_cast<EnterFunction>(const_cast<uchar *>(m_enter))(&state, code);
+    *remaining = state.remaining;
+    *a = state.a;
+    *d = state.d;
+    *watchpointAddress = state.watchHit;
+    return address;
+#else
+    Q_UNUSED(code);
+    Q_UNUSED(ram);
+    Q_UNUSED(watches);
+    Q_UNUSED(a);
+    Q_UNUSED(d);
+    Q_UNUSED(remaining);
+    Q_UNUSED(watchpointAddress);
+    return -1;
+#endif
+}
+
+/**
+ * The entry routine saves the callee-saved registers it uses, loads the
+ * State into registers and jumps to the block. The exit routine stores
+ * them back and returns the address in eax. The lookup routine goes on at
+ * the translation of the block at eax, or exits when there is none.
+ */
+void HackJit::emitRuntime()
+{
+    Q_STATIC_ASSERT(offsetof(State, ram) == 0x00);
+    Q_STATIC_ASSERT(offsetof(State, codeTable) == 0x08);
+    Q_STATIC_ASSERT(offsetof(State, remaining) == 0x10);
+    Q_STATIC_ASSERT(offsetof(State, a) == 0x18);
+    Q_STATIC_ASSERT(offsetof(State, d) == 0x1a);
+    Q_STATIC_ASSERT(offsetof(State, watchHit) == 0x1c);
+    Q_STATIC_ASSERT(offsetof(State, watches) == 0x20);
+
+    CodeWriter writer(m_code);
+    m_enter = writer.pos();
+    writer.bytes({ 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57 });   // push rbx, r12..r15
+#if defined(Q_OS_WIN)
+    writer.bytes({ 0x48, 0x89, 0xcb });                     // mov rbx, rcx
+#else
+    writer.bytes({ 0x48, 0x89, 0xfb });                     // mov rbx, rdi
+#endif
+    writer.bytes({ 0x4c, 0x8b, 0x63, 0x00 });               // mov r12, [rbx + ram]
+    writer.bytes({ 0x44, 0x0f, 0xb7, 0x6b, 0x18 });         // movzx r13d, word [rbx + a]
+    writer.bytes({ 0x44, 0x0f, 0xb7, 0x73, 0x1a });         // movzx r14d, word [rbx + d]
+    writer.bytes({ 0x4c, 0x8b, 0x7b, 0x10 });               // mov r15, [rbx + remaining]
+#if defined(Q_OS_WIN)
+    writer.bytes({ 0xff, 0xe2 });                           // jmp rdx
+#else
+    writer.bytes({ 0xff, 0xe6 });                           // jmp rsi
+#endif
+
+    m_exit = writer.pos();
+    writer.bytes({ 0x66, 0x44, 0x89, 0x6b, 0x18 });         // mov [rbx + a], r13w
+    writer.bytes({ 0x66, 0x44, 0x89, 0x73, 0x1a });         // mov [rbx + d], r14w
+    writer.bytes({ 0x4c, 0x89, 0x7b, 0x10 });               // mov [rbx + remaining], r15
+    writer.bytes({ 0x41, 0x5f, 0x41, 0x5e, 0x41, 0x5d, 0x41, 0x5c, 0x5b });   // pop r15..r12, rbx
+    writer.bytes({ 0xc3 });                                 // ret
+
+    m_lookup = writer.pos();
+    writer.bytes({ 0x48, 0x8b, 0x53, 0x08 });               // mov rdx, [rbx + codeTable]
+    writer.bytes({ 0x48, 0x8b, 0x14, 0xc2 });               // mov rdx, [rdx + rax * 8]
+    writer.bytes({ 0x48, 0x85, 0xd2 });                     // test rdx, rdx
+    writer.jcc(CC_E, m_exit);
+    writer.bytes({ 0xff, 0xe2 });                           // jmp rdx
+
+    m_runtimeSize = int(writer.pos() - m_code);
+    m_codeSize = m_runtimeSize;
+}
+
+/**
+ * Every instruction becomes a few host instructions working on A and D in
+ * registers. While the block has set A to a constant, M is addressed
+ * directly and a jump goes to a known block. The block's budget check
+ * comes first, so that a budget too small for the whole block leaves it to
+ * the interpreter before anything ran. While watching, a block that finds a
+ * watched word written by the one before it exits there as well.
+ */
+void HackJit::translate(const HackCpu::Op *rom, int address)
+{
+    const int length = blockLength(rom, address);
+    CodeWriter writer(m_code + m_codeSize);
+    const uchar *entry = writer.pos();
+
+    writer.bytes({ 0x49, 0x81, 0xff });                     // cmp r15, length
+    writer.int32(length);
+    uchar *budgetExit = writer.jcc(CC_L, entry);
+    uchar *watchExit = NULL;
+    if (m_watching) {
+        writer.bytes({ 0x83, 0x7b, 0x1c, 0xff });           // cmp dword [rbx + watchHit], -1
+        watchExit = writer.jcc(CC_NE, entry);
+    }
+    writer.bytes({ 0x49, 0x81, 0xef });                     // sub r15, length
+    writer.int32(length);
+
+    int knownA = -1;
+    int jumpTarget = -1;
+    quint8 jump = 0;
+    for (int i = 0; i < length; i++) {
+        const HackCpu::Op& op = rom[(address + i) & ADDRESS_MASK];
+        if (op.handler == HackCpu::LOAD) {
+            writer.movR13dImm(op.value);
+            knownA = op.value;
+            continue;
+        }
+
+        const uint comp = op.value;
+        jump = op.flags & (HackCpu::JLT | HackCpu::JEQ | HackCpu::JGT);
+        jumpTarget = knownA >= 0 ? (knownA & ADDRESS_MASK) : -1;
+        if ((comp & 0x40) || (op.flags & HackCpu::DEST_M) || jump) {
+            if (knownA >= 0) {
+                writer.movEcxImm(knownA & ADDRESS_MASK);
+            } else {
+                writer.bytes({ 0x41, 0x0f, 0xb7, 0xcd });       // movzx ecx, r13w
+                writer.bytes({ 0x81, 0xe1 });                   // and ecx, 0x7fff
+                writer.int32(ADDRESS_MASK);
+            }
+        }
+
+        // x = D, or 0, then negated
+        if (comp & 0x20) {
+            if (comp & 0x10)
+                writer.movEaxImm(-1);
+            else
+                writer.bytes({ 0x31, 0xc0 });                   // xor eax, eax
+        } else {
+            writer.bytes({ 0x44, 0x89, 0xf0 });                 // mov eax, r14d
+            if (comp & 0x10)
+                writer.bytes({ 0xf7, 0xd0 });                   // not eax
+        }
+        // y = A or M, or 0, then negated
+        if (comp & 0x08) {
+            if (comp & 0x04)
+                writer.movEdxImm(-1);
+            else
+                writer.bytes({ 0x31, 0xd2 });                   // xor edx, edx
+        } else {
+            if (comp & 0x40)
+                writer.bytes({ 0x41, 0x0f, 0xb7, 0x14, 0x4c }); // movzx edx, word [r12 + rcx * 2]
+            else
+                writer.bytes({ 0x44, 0x89, 0xea });             // mov edx, r13d
+            if (comp & 0x04)
+                writer.bytes({ 0xf7, 0xd2 });                   // not edx
+        }
+        if (comp & 0x02)
+            writer.bytes({ 0x01, 0xd0 });                       // add eax, edx
+        else
+            writer.bytes({ 0x21, 0xd0 });                       // and eax, edx
+        if (comp & 0x01)
+            writer.bytes({ 0xf7, 0xd0 });                       // not eax
+
+        if (op.flags & HackCpu::DEST_M) {
+            writer.bytes({ 0x66, 0x41, 0x89, 0x04, 0x4c });     // mov [r12 + rcx * 2], ax
+            if (m_watching) {
+                writer.bytes({ 0x48, 0x8b, 0x53, 0x20 });       // mov rdx, [rbx + watches]
+                writer.bytes({ 0x80, 0x3c, 0x0a, 0x00 });       // cmp byte [rdx + rcx], 0
+                writer.bytes({ 0x74, 0x03 });                   // je +3
+                writer.bytes({ 0x89, 0x4b, 0x1c });             // mov [rbx + watchHit], ecx
+            }
+        }
+        if (op.flags & HackCpu::DEST_A) {
+            writer.bytes({ 0x41, 0x89, 0xc5 });                 // mov r13d, eax
+            knownA = -1;
+        }
+        if (op.flags & HackCpu::DEST_D)
+            writer.bytes({ 0x41, 0x89, 0xc6 });                 // mov r14d, eax
+    }
+
+    // Exits: jumps to known blocks are chained, other ones looked up.
+    QVector<QPair<uchar *, int> > links;
+    uchar *taken = NULL;
+    if (jump && jump != (HackCpu::JLT | HackCpu::JEQ | HackCpu::JGT)) {
+        writer.bytes({ 0x66, 0x85, 0xc0 });                     // test ax, ax
+        taken = writer.jcc(JUMP_CONDITIONS[jump], entry);
+    }
+    if (jump != (HackCpu::JLT | HackCpu::JEQ | HackCpu::JGT)) {
+        const int next = (address + length) & ADDRESS_MASK;
+        writer.movEaxImm(next);
+        links.append(qMakePair(writer.jmp(m_lookup), next));
+    }
+    if (jump) {
+        if (taken)
+            writer.bind(taken);
+        if (jumpTarget >= 0) {
+            writer.movEaxImm(jumpTarget);
+            links.append(qMakePair(writer.jmp(m_lookup), jumpTarget));
+        } else {
+            writer.bytes({ 0x89, 0xc8 });                       // mov eax, ecx
+            writer.jmp(m_lookup);
+        }
+    }
+
+    writer.bind(budgetExit);
+    if (watchExit)
+        writer.bind(watchExit);
+    writer.movEaxImm(address);
+    writer.jmp(m_exit);
+
+    m_codeSize = int(writer.pos() - m_code);
+    for (const QPair<uchar *, int>& exit : links) {
+        if (const void *target = m_codeTable.at(exit.second))
+            CodeWriter(exit.first).rel32(static_cast<const uchar *>(target));
+        else
+            m_pendingLinks[exit.second].append(int(exit.first - m_code));
+    }
+    link(address, entry);
+}
+
+/**
+ * Publishes the translation of the block at address and points the jumps
+ * that waited for it there, instead of at the lookup routine.
+ */
+void HackJit::link(int address, const void *code)
+{
+    m_codeTable[address] = code;
+    const QVector<int> links = m_pendingLinks.take(address);
+    for (int offset : links)
+        CodeWriter(m_code + offset).rel32(static_cast<const uchar *>(code));
+}
@@ -0,0 +1,89 @@
+#ifndef HACKJIT_H
+#define HACKJIT_H
+
+#include <QHash>
+#include <QVector>
+
+#include "hackcpu.h"
+
+// Translates basic blocks of a HackCpu's ROM into x86-64 code once they
+// have run often enough. A block starts wherever execution arrives and
+// ends with its first jump. Blocks that leave through a jump to a known
+// address, or by falling through, are chained straight into the block
+// they go to once it is translated; the others look their target up in a
+// table. Translated code keeps A and D in host registers and runs until
+// it reaches code that is not translated, a halt loop or the end of its
+// instruction budget. While RAM words are watched, blocks end after every
+// write to M and check it against the watched words. Where the host is not
+// x86-64 or no executable memory can be had, isValid() is false and
+// nothing is translated.
+class HackJit
+{
+public:
+    static bool isSupported();
+
+    HackJit();
+    ~HackJit();
+
+    bool isValid() const { return m_code != NULL; }
+    // Forgets all translations, for a new program.
+    void clear();
+    // Whether translated code checks writes to M for watched words; changing
+    // it forgets all translations.
+    void setWatching(bool watching);
+
+    // The number of instructions of the block starting at address.
+    int blockLength(const HackCpu::Op *rom, int address);
+    // Counts an interpreted run of the block, translating it once it is hot.
+    void countExecution(const HackCpu::Op *rom, int address);
+    // The translation of the block starting at address, or NULL.
+    const void *code(int address) const { return m_codeTable.at(address); }
+
+    // Runs translated code from the start of a block until it leaves
+    // translated code or less than a whole block of the budget is left.
+    // Returns the address to go on from. A write to a word flagged in
+    // watches ends the run after its block and sets *watchpointAddress.
+    int run(const void *code, quint16 *ram, const quint8 *watches, quint16 *a, quint16 *d,
+            qint64 *remaining, int *watchpointAddress) const;
+
+private:
+    Q_DISABLE_COPY(HackJit)
+
+    static const int MAX_BLOCK_LENGTH;
+    static const int MAX_BLOCK_CODE_SIZE;
+    static const int CODE_CAPACITY;
+    static const int HOT_BLOCK_EXECUTIONS;
+
+    // What translated code reads and writes, at offsets fixed in the code.
+    struct State {
+        quint16 *ram;
+        const void *const *codeTable;
+        qint64 remaining;
+        quint16 a;
+        quint16 d;
+        qint32 watchHit;    // -1 until a watched word is written
+        const quint8 *watches;
+    };
+
+    void emitRuntime();
+    void translate(const HackCpu::Op *rom, int address);
+    void link(int address, const void *code);
+
+    uchar *m_code;
+    int m_codeSize;
+    int m_runtimeSize;
+    bool m_watching;
+    // Entry, exit and table lookup routines shared by all blocks.
+    const uchar *m_enter;
+    const uchar *m_exit;
+    const uchar *m_lookup;
+
+    QVector<const void *> m_codeTable;
+    QVector<quint16> m_blockLengths;    // 0 until measured
+    QVector<quint16> m_executions;
+    // Jumps to blocks not translated yet, by block address: the offsets of
+    // their rel32 operands, to point them at the block once it is.
+    QHash<int, QVector<int> > m_pendingLinks;
+};
+
+#endif // HACKJIT_H
@@ -1,65 +1,217 @@
 #include <QtGlobal>
 #include "assemblercontroller.h"
 
+// 60 Hz, of which half may go to translating and showing the new lines.
+const int AssemblerController::FRAME_INTERVAL = 16;
+const qint64 AssemblerController::FRAME_BUDGET_NSECS = 8000000;
+const int AssemblerController::MAX_FRAME_LINE_COUNT = 1 << 20;
+const int AssemblerController::TURBO_LINES_PER_SECOND = 1000;
+const int AssemblerController::RATE_UPDATE_INTERVAL = 500;
+
 AssemblerController::AssemblerController(QObject *parent)
    : QObject(parent),
+     m_worker(NULL),
+     m_generation(0),
+     m_sourceLineCount(0),
+     m_translatedLineCount(0),
+     m_translateAllPending(false),
+     m_stepPending(false),
      m_timer(NULL),
      m_speed(NORMAL),
+     m_frameLineCount(1),
+     m_turboLineCredit(0),
+     m_rateLineCount(0),
      m_state(NO_SOURCE)
 {
+    qRegisterMetaType<AssemblySnapshotPointer>();
+
+    AssemblySnapshot *emptySnapshot = new AssemblySnapshot;
+    emptySnapshot->generation = 0;
+    emptySnapshot->isSourceBlank = true;
+    m_snapshot = AssemblySnapshotPointer(emptySnapshot);
+
     m_timer = new QTimer(this);
     connect(m_timer, &QTimer::timeout, this, &AssemblerController::timerUpdate);
+
+    m_worker = new AssemblerWorker(&m_generation);
+    m_worker->moveToThread(&m_workerThread);
+    connect(&m_workerThread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(m_worker, &AssemblerWorker::assembled, this, &AssemblerController::workerAssembled);
+    m_workerThread.start();
+}
+
+AssemblerController::~AssemblerController()
+{
+    nextGeneration();
+    m_workerThread.quit();
+    m_workerThread.wait();
+}
+
+/**
+ * Starts a new generation of the source, which cancels the job the worker
+ * may be running, and forgets the translation progress of the previous one.
+ */
+int AssemblerController::nextGeneration()
+{
+    m_translatedLineCount = 0;
+    m_translateAllPending = false;
+    m_stepPending = false;
+    return m_generation.fetchAndAddOrdered(1) + 1;
 }
 
 void AssemblerController::setSourceCode(const QString &asmSource)
 {
-    m_assembler.setSourceCode(asmSource);
+    m_sourceLineCount = SourceText::countLines(asmSource);
+    const int generation = nextGeneration();
+    AssemblerWorker *worker = m_worker;
+    QMetaObject::invokeMethod(m_worker, [worker, generation, asmSource]() {
+        worker->setSourceCode(generation, asmSource);
+    }, Qt::QueuedConnection);
     setState(asmSource.trimmed().isEmpty() ? NO_SOURCE : RESET);
-    m_assembler.parse();
 }
 
-bool AssemblerController::lineHasError(int line) const
+void AssemblerController::replaceSourceLines(int firstLine, int removedCount, const QStringList& lines)
 {
-    if (m_assembler.errors().isEmpty())
-        return false;
-    for (const Assembler::Error& error : m_assembler.errors()) {
-        if (error.line == line)
-            return true;
-    }
-    return false;
+    m_sourceLineCount += lines.size() - removedCount;
+    const int generation = nextGeneration();
+    AssemblerWorker *worker = m_worker;
+    QMetaObject::invokeMethod(m_worker, [worker, generation, firstLine, removedCount, lines]() {
+        worker->replaceSourceLines(generation, firstLine, removedCount, lines);
+    }, Qt::QueuedConnection);
+    // Whether the source became blank is known once the worker is done.
+    setState(m_state == NO_SOURCE ? NO_SOURCE : RESET);
+}
+
+void AssemblerController::workerAssembled(AssemblySnapshotPointer snapshot)
+{
+    if (snapshot->generation != m_generation.load())
+        return;
+
+    m_snapshot = snapshot;
+    if (m_state == NO_SOURCE || m_state == RESET)
+        setState(m_snapshot->isSourceBlank ? NO_SOURCE : RESET);
+    emit assembled();
+
+    if (m_translateAllPending)
+        translateAll();
+    else if (m_stepPending)
+        translateNextLine();
+}
+
+int AssemblerController::sourceLineForBinaryLine(int line) const
+{
+    if (line < 0 || line >= m_translatedLineCount)
+        return -1;
+    return m_snapshot->sourceLineForBinaryLine(line);
+}
+
+int AssemblerController::binaryLineForSourceLine(int line) const
+{
+    int binaryLine = m_snapshot->binaryLineForSourceLine(line);
+    return binaryLine < m_translatedLineCount ? binaryLine : -1;
 }
 
 void AssemblerController::timerUpdate()
 {
-    translateNextLine();
+    if (!isSnapshotCurrent())
+        return;
+    if (m_speed >= TURBO)
+        translateFrame();
+    else
+        translateNextLine();
     if (m_timer->interval() != timerInterval())
         m_timer->setInterval(timerInterval());
 }
 
 int AssemblerController::timerInterval()
 {
+    if (m_speed >= TURBO)
+        return FRAME_INTERVAL;
+
     static const int NORMAL_TIMER_INTERVAL = 1000;
     static const double INTERVAL_MULTIPLIER[] = { 2.0, 1.5, 1.0, 0.5, 0.25 };
     return qRound(NORMAL_TIMER_INTERVAL * INTERVAL_MULTIPLIER[m_speed]);
 }
 
+/**
+ * The worker translates the whole source in the background; stepping
+ * through the translation hands out one more of its lines. A step asked for
+ * before the current source has been assembled runs when it is.
+ */
 void AssemblerController::translateNextLine()
 {
-    m_assembler.translateNextLine();
-    if (m_assembler.hasMoreLines())
-        emit currentLineChanged(m_assembler.binaryCode().length() - 1);
-    else
+    if (!isSnapshotCurrent()) {
+        m_stepPending = true;
+        return;
+    }
+    m_stepPending = false;
+
+    if (m_translatedLineCount < m_snapshot->binaryCode.size()) {
+        int line = m_translatedLineCount++;
+        emit currentLineChanged(line);
+    }
+    if (m_translatedLineCount == m_snapshot->binaryCode.size())
         setState(FINISHED);
 }
 
+/**
+ * Handing out lines is cheap, showing them is not: the batch size follows
+ * how long the previous frames took, the receivers of currentLineChanged
+ * included, so that each stays within FRAME_BUDGET_NSECS. TURBO also hands
+ * out no more than its rate allows, so the translation stays watchable.
+ */
+void AssemblerController::translateFrame()
+{
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+
+    int lineCount = qMin(m_frameLineCount, m_snapshot->binaryCode.size() - m_translatedLineCount);
+    if (m_speed == TURBO) {
+        m_turboLineCredit += TURBO_LINES_PER_SECOND * m_frameClock.restart() / 1000.0;
+        m_turboLineCredit = qMin(m_turboLineCredit, double(m_frameLineCount));
+        lineCount = qMin(lineCount, int(m_turboLineCredit));
+        m_turboLineCredit -= lineCount;
+    }
+
+    if (lineCount > 0) {
+        m_translatedLineCount += lineCount;
+        emit currentLineChanged(m_translatedLineCount - 1);
+    }
+    if (m_translatedLineCount == m_snapshot->binaryCode.size())
+        setState(FINISHED);
+
+    const qint64 elapsed = frameTimer.nsecsElapsed();
+    if (elapsed > FRAME_BUDGET_NSECS)
+        m_frameLineCount = qMax(1, m_frameLineCount / 2);
+    else if (elapsed < FRAME_BUDGET_NSECS / 2 && lineCount == m_frameLineCount)
+        m_frameLineCount = qMin(2 * m_frameLineCount, MAX_FRAME_LINE_COUNT);
+
+    updateTranslationRate(lineCount);
+}
+
+void AssemblerController::updateTranslationRate(int lineCount)
+{
+    m_rateLineCount += lineCount;
+    const qint64 elapsed = m_rateClock.elapsed();
+    if (elapsed < RATE_UPDATE_INTERVAL && m_state == RUNNING)
+        return;
+    emit translationRateChanged(elapsed > 0 ? int(m_rateLineCount * Q_INT64_C(1000) / elapsed) : 0);
+    m_rateLineCount = 0;
+    m_rateClock.restart();
+}
+
 void AssemblerController::setState(AssemblerController::State newState)
 {
     if (m_state == newState) return;
     m_state = newState;
 
-    if (m_state == RUNNING)
+    if (m_state == RUNNING) {
+        m_turboLineCredit = 0;
+        m_rateLineCount = 0;
+        m_frameClock.start();
+        m_rateClock.start();
         m_timer->start(0);
-    else if (m_timer->isActive())
+    } else if (m_timer->isActive())
         m_timer->stop();
 
     emit stateChanged(m_state);
@@ -88,12 +240,19 @@ void AssemblerController::step()
 
 void AssemblerController::reset()
 {
-    m_assembler.clearTranslationData();
+    m_translatedLineCount = 0;
+    m_translateAllPending = false;
+    m_stepPending = false;
     setState(RESET);
 }
 
 void AssemblerController::translateAll()
 {
-    m_assembler.translateAll();
+    if (!isSnapshotCurrent()) {
+        m_translateAllPending = true;
+        return;
+    }
+    m_translateAllPending = false;
+    m_translatedLineCount = m_snapshot->binaryCode.size();
     setState(FINISHED);
 }
@@ -1,10 +1,15 @@
 #ifndef ASSEMBLERCONTROLLER_H
 #define ASSEMBLERCONTROLLER_H
 
+#include <QAtomicInt>
+#include <QElapsedTimer>
 #include <QObject>
 #include <QTextEdit>
+#include <QThread>
 #include <QTimer>
 
+#include "assemblerworker.h"
+#include "assemblysnapshot.h"
 #include "hackassembler/assembler.h"
 
 class AssemblerController : public QObject
@@ -25,19 +30,31 @@ public:
         SLOW,       // x0.5
         NORMAL,     // x1
         FAST,       // x1.5
-        FASTER      // x2
+        FASTER,     // x2
+        TURBO,      // TURBO_LINES_PER_SECOND, in batches once per frame
+        MAXIMUM     // As many lines per frame as fit in its time budget
     };
 
     explicit AssemblerController(QObject *parent = 0);
+    ~AssemblerController();
 
     void setSourceCode(const QString& asmSource);
-    const QStringList& binaryCode() const { return m_assembler.binaryCode(); }
+    void replaceSourceLines(int firstLine, int removedCount, const QStringList& lines);
+    int sourceLineCount() const { return m_sourceLineCount; }
 
-    const Assembler::ErrorList& errors() const { return m_assembler.errors(); }
-    bool lineHasError(int line) const;
+    // Whole translation of the latest assembled source; only the first
+    // translatedLineCount() instructions have been stepped through.
+    const QVector<quint16>& binaryCode() const { return m_snapshot->binaryCode; }
+    int translatedLineCount() const { return m_translatedLineCount; }
 
-    int sourceLineForBinaryLine(int line) { return m_assembler.sourceLineForBinaryLine(line); }
-    int binaryLineForSourceLine(int line) { return m_assembler.binaryLineForSourceLine(line); }
+    // Whether the latest source has been assembled; until then, errors()
+    // and binaryCode() are those of an earlier version.
+    bool isAssembled() const { return isSnapshotCurrent(); }
+
+    const Assembler::ErrorList& errors() const { return m_snapshot->errors; }
+
+    int sourceLineForBinaryLine(int line) const;
+    int binaryLineForSourceLine(int line) const;
 
     State state() { return m_state; }
     void setState(State newState);
@@ -52,18 +69,51 @@ public:
 
 signals:
     void stateChanged(AssemblerController::State newState);
+    // The translation advanced up to line; at turbo speeds several lines
+    // at once.
     void currentLineChanged(int line);
+    // Lines translated per second while running at a turbo speed.
+    void translationRateChanged(int linesPerSecond);
+    // A newer version of the source has been assembled: errors() and the
+    // line mappings changed.
+    void assembled();
 
 private slots:
     void timerUpdate();
+    void workerAssembled(AssemblySnapshotPointer snapshot);
 
 private:
     int timerInterval();
     void translateNextLine();
+    void translateFrame();
+    void updateTranslationRate(int lineCount);
+    static const int FRAME_INTERVAL;
+    static const qint64 FRAME_BUDGET_NSECS;
+    static const int MAX_FRAME_LINE_COUNT;
+    static const int TURBO_LINES_PER_SECOND;
+    static const int RATE_UPDATE_INTERVAL;
+
+    bool isSnapshotCurrent() const { return m_snapshot->generation == m_generation.load(); }
+    int nextGeneration();
+
+    QThread m_workerThread;
+    AssemblerWorker *m_worker;
+    QAtomicInt m_generation;
+    AssemblySnapshotPointer m_snapshot;
+    int m_sourceLineCount;
+    int m_translatedLineCount;
+    bool m_translateAllPending;
+    bool m_stepPending;
 
-    Assembler m_assembler;
     QTimer *m_timer;
     Speed m_speed;
+    // Turbo speeds: the lines handed out per frame, adjusted to the frame
+    // budget, and the lines owed at the TURBO rate.
+    int m_frameLineCount;
+    double m_turboLineCredit;
+    QElapsedTimer m_frameClock;
+    QElapsedTimer m_rateClock;
+    int m_rateLineCount;
     State m_state;
 };
 
@@ -0,0 +1,115 @@
+#include <algorithm>
+
+#include <QMutex>
+#include <QMutexLocker>
+
+#include "assemblerworker.h"
+
+namespace {
+
+/**
+ * Copies the elements rather than sharing the source's buffer, which the
+ * assembler would then have to detach from on its next pass.
+ */
+template <typename T>
+void copyInto(QVector<T>& buffer, const QVector<T>& source)
+{
+    buffer.resize(source.size());
+    std::copy(source.constBegin(), source.constEnd(), buffer.begin());
+}
+
+} // namespace
+
+// Snapshots released by the editor, returned by the deleter of their
+// pointer on whichever thread released them last.
+struct AssemblerWorker::SnapshotPool
+{
+    ~SnapshotPool() { qDeleteAll(snapshots); }
+
+    QMutex lock;
+    QVector<AssemblySnapshot *> snapshots;
+};
+
+const int AssemblerWorker::CANCEL_CHECK_INTERVAL = 4096;
+const int AssemblerWorker::PARALLEL_TRANSLATION_LINES = 65536;
+
+AssemblerWorker::AssemblerWorker(const QAtomicInt *latestGeneration)
+    : QObject(),
+      m_latestGeneration(latestGeneration),
+      m_snapshotPool(new SnapshotPool)
+{
+}
+
+void AssemblerWorker::setSourceCode(int generation, const QString& asmSource)
+{
+    m_assembler.setSourceCode(asmSource);
+    // If this is abandoned before parsing, the next edit parses everything.
+    if (isCanceled(generation))
+        return;
+    m_assembler.parse(m_pool);
+    assemble(generation);
+}
+
+/**
+ * Edits are always applied, in order, since each one builds on the previous
+ * source; only the translation and publishing of outdated ones is skipped.
+ */
+void AssemblerWorker::replaceSourceLines(int generation, int firstLine, int removedCount, const QStringList& lines)
+{
+    m_assembler.replaceSourceLines(firstLine, removedCount, lines);
+    assemble(generation);
+}
+
+/**
+ * Large sources are translated on all cores in one go; that can't be
+ * interrupted, but finishes well before the line-by-line loop would have
+ * reached its first few cancellation checks.
+ */
+void AssemblerWorker::assemble(int generation)
+{
+    if (isCanceled(generation))
+        return;
+
+    if (m_assembler.asmSrcCode().lineCount() >= PARALLEL_TRANSLATION_LINES) {
+        m_assembler.translateAll(m_pool);
+        if (isCanceled(generation))
+            return;
+    } else {
+        m_assembler.clearTranslationData();
+        int translatedLines = 0;
+        while (m_assembler.hasMoreLines()) {
+            m_assembler.translateNextLine();
+            if (++translatedLines % CANCEL_CHECK_INTERVAL == 0 && isCanceled(generation))
+                return;
+        }
+    }
+
+    AssemblySnapshot *snapshot = takeSnapshot();
+    snapshot->generation = generation;
+    snapshot->isSourceBlank = m_assembler.isSourceBlank();
+    copyInto(snapshot->binaryCode, m_assembler.binaryCode());
+    copyInto(snapshot->errors, m_assembler.errors());
+    copyInto(snapshot->srcToBinLines, m_assembler.sourceToBinaryLines());
+    copyInto(snapshot->binToSrcLines, m_assembler.binaryToSourceLines());
+
+    QSharedPointer<SnapshotPool> pool = m_snapshotPool;
+    emit assembled(AssemblySnapshotPointer(snapshot, [pool](AssemblySnapshot *released) {
+        QMutexLocker locker(&pool->lock);
+        pool->snapshots.append(released);
+    }));
+}
+
+/**
+ * Only the editor's current snapshot and the ones still queued to it are
+ * in use, so the pool stays at a few snapshots. A buffer the editor's
+ * models still share is detached from when it is copied into.
+ */
+AssemblySnapshot *AssemblerWorker::takeSnapshot()
+{
+    QMutexLocker locker(&m_snapshotPool->lock);
+    if (m_snapshotPool->snapshots.isEmpty())
+        return new AssemblySnapshot;
+    AssemblySnapshot *snapshot = m_snapshotPool->snapshots.last();
+    m_snapshotPool->snapshots.removeLast();
+    return snapshot;
+}
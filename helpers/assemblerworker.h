@@ -0,0 +1,46 @@
+#ifndef ASSEMBLERWORKER_H
+#define ASSEMBLERWORKER_H
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QSharedPointer>
+#include <QStringList>
+
+#include "assemblysnapshot.h"
+#include "hackassembler/assembler.h"
+#include "hackassembler/workstealingpool.h"
+
+// Owns the Assembler and runs it on a thread of its own. Every job carries
+// the generation of the edit that queued it; a job gives up as soon as a
+// newer generation has been queued. Results are copied into snapshots whose
+// buffers are reused once nothing refers to them any more.
+class AssemblerWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit AssemblerWorker(const QAtomicInt *latestGeneration);
+
+    void setSourceCode(int generation, const QString& asmSource);
+    void replaceSourceLines(int generation, int firstLine, int removedCount, const QStringList& lines);
+
+signals:
+    void assembled(AssemblySnapshotPointer snapshot);
+
+private:
+    struct SnapshotPool;
+
+    void assemble(int generation);
+    AssemblySnapshot *takeSnapshot();
+    bool isCanceled(int generation) const { return m_latestGeneration->load() != generation; }
+
+    static const int CANCEL_CHECK_INTERVAL;
+    static const int PARALLEL_TRANSLATION_LINES;
+
+    Assembler m_assembler;
+    WorkStealingPool m_pool;
+    const QAtomicInt *m_latestGeneration;
+    // Shared with the published snapshots, which may outlive the worker.
+    QSharedPointer<SnapshotPool> m_snapshotPool;
+};
+
+#endif // ASSEMBLERWORKER_H
@@ -0,0 +1,40 @@
+#ifndef ASSEMBLYSNAPSHOT_H
+#define ASSEMBLYSNAPSHOT_H
+
+#include <QMetaType>
+#include <QSharedPointer>
+#include <QVector>
+
+#include "hackassembler/assembler.h"
+
+// Result of assembling one version of the source, published by the
+// assembler worker thread. It is never modified once published.
+struct AssemblySnapshot
+{
+    int generation;
+    bool isSourceBlank;
+    QVector<quint16> binaryCode;
+    Assembler::ErrorList errors;
+    QVector<int> srcToBinLines;        // Next instruction for lines without one
+    QVector<quint32> binToSrcLines;
+
+    int sourceLineForBinaryLine(int binaryLineNumber) const
+    {
+        if (binaryLineNumber < 0 || binaryLineNumber >= binToSrcLines.size())
+            return -1;
+        return int(binToSrcLines.at(binaryLineNumber));
+    }
+
+    int binaryLineForSourceLine(int sourceLineNumber) const
+    {
+        if (sourceLineNumber < 0 || sourceLineNumber >= srcToBinLines.size())
+            return -1;
+        int binaryLineNumber = srcToBinLines.at(sourceLineNumber);
+        return binaryLineNumber < binaryCode.size() ? binaryLineNumber : -1;
+    }
+};
+
+typedef QSharedPointer<const AssemblySnapshot> AssemblySnapshotPointer;
+Q_DECLARE_METATYPE(AssemblySnapshotPointer)
+
+#endif // ASSEMBLYSNAPSHOT_H
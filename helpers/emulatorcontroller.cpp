@@ -0,0 +1,172 @@
+#include "emulatorcontroller.h"
+
+// 60 Hz, the rate at which the snapshot is polled.
+const int EmulatorController::FRAME_INTERVAL = 16;
+const int EmulatorController::RATE_UPDATE_INTERVAL = 500;
+
+EmulatorController::EmulatorController(QObject *parent)
+    : QObject(parent),
+      m_worker(NULL),
+      m_pauseRequested(0),
+      m_command(0),
+      m_hasProgram(false),
+      m_isRunning(false),
+      m_timer(NULL),
+      m_rateInstructionCount(-1)
+{
+    m_timer = new QTimer(this);
+    m_timer->setInterval(FRAME_INTERVAL);
+    connect(m_timer, &QTimer::timeout, this, &EmulatorController::timerUpdate);
+
+    m_worker = new EmulatorWorker(&m_pauseRequested, &m_snapshots);
+    m_worker->moveToThread(&m_workerThread);
+    connect(&m_workerThread, &QThread::finished, m_worker, &QObject::deleteLater);
+    m_workerThread.start();
+}
+
+EmulatorController::~EmulatorController()
+{
+    m_pauseRequested.storeRelease(1);
+    m_workerThread.quit();
+    m_workerThread.wait();
+}
+
+/**
+ * Every command is queued to the worker, which publishes a snapshot once
+ * it has handled it; the timer polls until that one has been seen.
+ */
+void EmulatorController::loadProgram(const QVector<quint16>& program)
+{
+    const int command = nextCommand();
+    EmulatorWorker *worker = m_worker;
+    QMetaObject::invokeMethod(m_worker, [worker, command, program]() {
+        worker->loadProgram(command, program);
+    }, Qt::QueuedConnection);
+    m_hasProgram = true;
+    setRunning(false);
+    m_timer->start();
+}
+
+void EmulatorController::run()
+{
+    m_pauseRequested.storeRelease(0);
+    const int command = nextCommand();
+    EmulatorWorker *worker = m_worker;
+    QMetaObject::invokeMethod(m_worker, [worker, command]() {
+        worker->run(command);
+    }, Qt::QueuedConnection);
+    setRunning(true);
+    m_timer->start();
+}
+
+/**
+ * The worker sees the request before its next slice, without waiting for
+ * the commands queued ahead of it.
+ */
+void EmulatorController::pause()
+{
+    m_pauseRequested.storeRelease(1);
+    setRunning(false);
+}
+
+void EmulatorController::step()
+{
+    if (m_isRunning)
+        pause();
+    const int command = nextCommand();
+    EmulatorWorker *worker = m_worker;
+    QMetaObject::invokeMethod(m_worker, [worker, command]() {
+        worker->step(command);
+    }, Qt::QueuedConnection);
+    m_timer->start();
+}
+
+void EmulatorController::reset()
+{
+    if (m_isRunning)
+        pause();
+    const int command = nextCommand();
+    EmulatorWorker *worker = m_worker;
+    QMetaObject::invokeMethod(m_worker, [worker, command]() {
+        worker->reset(command);
+    }, Qt::QueuedConnection);
+    m_timer->start();
+}
+
+void EmulatorController::setBreakpoint(int address, bool enabled)
+{
+    if (enabled)
+        m_breakpoints.insert(address);
+    else
+        m_breakpoints.remove(address);
+    const int command = nextCommand();
+    EmulatorWorker *worker = m_worker;
+    QMetaObject::invokeMethod(m_worker, [worker, command, address, enabled]() {
+        worker->setBreakpoint(command, address, enabled);
+    }, Qt::QueuedConnection);
+    m_timer->start();
+}
+
+void EmulatorController::setWatchpoint(int address, bool enabled)
+{
+    if (enabled)
+        m_watchpoints.insert(address);
+    else
+        m_watchpoints.remove(address);
+    const int command = nextCommand();
+    EmulatorWorker *worker = m_worker;
+    QMetaObject::invokeMethod(m_worker, [worker, command, address, enabled]() {
+        worker->setWatchpoint(command, address, enabled);
+    }, Qt::QueuedConnection);
+    m_timer->start();
+}
+
+void EmulatorController::setRamWindow(int window, int first)
+{
+    const int command = nextCommand();
+    EmulatorWorker *worker = m_worker;
+    QMetaObject::invokeMethod(m_worker, [worker, command, window, first]() {
+        worker->setRamWindow(command, window, first);
+    }, Qt::QueuedConnection);
+    m_timer->start();
+}
+
+/**
+ * Snapshots of commands older than the latest one are shown, but only the
+ * latest one tells whether the worker stopped running by itself, at a
+ * breakpoint, a watchpoint or a halt loop. Polling ends once the worker is
+ * idle and has caught up.
+ */
+void EmulatorController::timerUpdate()
+{
+    if (!m_snapshots.update())
+        return;
+    const EmulatorSnapshot& current = m_snapshots.readBuffer();
+    const bool isCurrent = current.command == m_command;
+
+    if (m_isRunning && isCurrent) {
+        if (m_rateInstructionCount < 0) {
+            m_rateInstructionCount = current.instructionCount;
+            m_rateClock.start();
+        } else if (m_rateClock.elapsed() >= RATE_UPDATE_INTERVAL) {
+            const qint64 count = current.instructionCount - m_rateInstructionCount;
+            emit instructionRateChanged(count * Q_INT64_C(1000) / m_rateClock.restart());
+            m_rateInstructionCount = current.instructionCount;
+        }
+        if (!current.isRunning)
+            setRunning(false);
+    }
+    emit updated();
+
+    if (isCurrent && !current.isRunning)
+        m_timer->stop();
+}
+
+void EmulatorController::setRunning(bool running)
+{
+    if (m_isRunning == running)
+        return;
+    m_isRunning = running;
+    m_rateInstructionCount = -1;
+    emit runningChanged(m_isRunning);
+}
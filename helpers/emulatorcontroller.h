@@ -0,0 +1,78 @@
+#ifndef EMULATORCONTROLLER_H
+#define EMULATORCONTROLLER_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QSet>
+#include <QThread>
+#include <QTimer>
+
+#include "emulatorsnapshot.h"
+#include "emulatorworker.h"
+#include "triplebuffer.h"
+
+class EmulatorController : public QObject
+{
+    Q_OBJECT
+public:
+    explicit EmulatorController(QObject *parent = 0);
+    ~EmulatorController();
+
+    void loadProgram(const QVector<quint16>& program);
+    // Whether a program is loaded and the state shown is its own.
+    bool hasProgram() const { return m_hasProgram; }
+
+    bool isRunning() const { return m_isRunning; }
+    void run();
+    void pause();
+    void step();
+    void reset();
+
+    // By ROM address, that is, line of the translated code.
+    void setBreakpoint(int address, bool enabled);
+    bool hasBreakpoint(int address) const { return m_breakpoints.contains(address); }
+    const QSet<int>& breakpoints() const { return m_breakpoints; }
+    void setWatchpoint(int address, bool enabled);
+    bool hasWatchpoint(int address) const { return m_watchpoints.contains(address); }
+    const QSet<int>& watchpoints() const { return m_watchpoints; }
+    // Shows RAM_WINDOW_SIZE words from first in the snapshot's window.
+    void setRamWindow(int window, int first);
+
+    // The latest state published by the worker.
+    const EmulatorSnapshot& snapshot() const { return m_snapshots.readBuffer(); }
+
+signals:
+    // A new snapshot() was taken, at most once per frame.
+    void updated();
+    void runningChanged(bool running);
+    // Instructions run per second while running.
+    void instructionRateChanged(qint64 instructionsPerSecond);
+
+private slots:
+    void timerUpdate();
+
+private:
+    int nextCommand() { return ++m_command; }
+    void setRunning(bool running);
+
+    static const int FRAME_INTERVAL;
+    static const int RATE_UPDATE_INTERVAL;
+
+    QThread m_workerThread;
+    EmulatorWorker *m_worker;
+    QAtomicInt m_pauseRequested;
+    TripleBuffer<EmulatorSnapshot> m_snapshots;
+    // The number of commands queued to the worker so far.
+    int m_command;
+    bool m_hasProgram;
+    bool m_isRunning;
+    QSet<int> m_breakpoints;
+    QSet<int> m_watchpoints;
+
+    QTimer *m_timer;
+    QElapsedTimer m_rateClock;
+    qint64 m_rateInstructionCount;
+};
+
+#endif // EMULATORCONTROLLER_H
@@ -0,0 +1,36 @@
+#ifndef EMULATORSNAPSHOT_H
+#define EMULATORSNAPSHOT_H
+
+#include "hackemulator/hackcpu.h"
+
+// The state of the emulated CPU that the UI shows, published by the
+// emulator worker thread after every slice it runs and every command it
+// handles. It is a plain value of fixed size, so publishing it copies a few
+// hundred bytes and never allocates.
+struct EmulatorSnapshot
+{
+    enum {
+        RAM_WINDOW_COUNT = 2,
+        RAM_WINDOW_SIZE = 16
+    };
+
+    // RAM_WINDOW_SIZE words of RAM starting at first.
+    struct RamWindow {
+        int first;
+        quint16 words[RAM_WINDOW_SIZE];
+    };
+
+    // The number of commands the worker had handled; the snapshot shows
+    // their results, and none of the later ones.
+    int command;
+    bool isRunning;
+    HackCpu::StopReason stopReason;
+    int watchpointAddress;
+    quint16 a;
+    quint16 d;
+    int pc;
+    qint64 instructionCount;
+    RamWindow ramWindows[RAM_WINDOW_COUNT];
+};
+
+#endif // EMULATORSNAPSHOT_H
@@ -0,0 +1,123 @@
+#include "emulatorworker.h"
+
+// A few milliseconds of translated code, about ten interpreted.
+const qint64 EmulatorWorker::SLICE_INSTRUCTIONS = 1 << 22;
+
+EmulatorWorker::EmulatorWorker(const QAtomicInt *pauseRequested, TripleBuffer<EmulatorSnapshot> *snapshots)
+    : QObject(),
+      m_pauseRequested(pauseRequested),
+      m_snapshots(snapshots),
+      m_command(0),
+      m_isRunning(false)
+{
+    for (int window = 0; window < EmulatorSnapshot::RAM_WINDOW_COUNT; window++)
+        m_ramWindows[window] = window * EmulatorSnapshot::RAM_WINDOW_SIZE;
+}
+
+/**
+ * A new program starts over from a cleared RAM; breakpoints and watchpoints
+ * are kept, as they are set by address.
+ */
+void EmulatorWorker::loadProgram(int command, const QVector<quint16>& program)
+{
+    m_command = command;
+    m_isRunning = false;
+    m_cpu.loadProgram(program);
+    m_cpu.clearRam();
+    publish();
+}
+
+void EmulatorWorker::reset(int command)
+{
+    m_command = command;
+    m_isRunning = false;
+    m_cpu.reset();
+    m_cpu.clearRam();
+    publish();
+}
+
+/**
+ * A run already going on, from before a pause that it has not seen yet,
+ * just goes on.
+ */
+void EmulatorWorker::run(int command)
+{
+    m_command = command;
+    if (m_isRunning)
+        return;
+    m_isRunning = true;
+    runSlice();
+}
+
+void EmulatorWorker::step(int command)
+{
+    m_command = command;
+    m_isRunning = false;
+    m_cpu.step();
+    publish();
+}
+
+void EmulatorWorker::setBreakpoint(int command, int address, bool enabled)
+{
+    m_command = command;
+    m_cpu.setBreakpoint(address, enabled);
+    publish();
+}
+
+void EmulatorWorker::setWatchpoint(int command, int address, bool enabled)
+{
+    m_command = command;
+    m_cpu.setWatchpoint(address, enabled);
+    publish();
+}
+
+void EmulatorWorker::setRamWindow(int command, int window, int first)
+{
+    m_command = command;
+    m_ramWindows[window] = qBound(0, first, HackCpu::RAM_SIZE - EmulatorSnapshot::RAM_WINDOW_SIZE);
+    publish();
+}
+
+/**
+ * Each slice is queued behind the commands that arrived while the previous
+ * one ran, so they are handled in between. Breakpoints and watchpoints are
+ * checked by the CPU itself as it runs.
+ */
+void EmulatorWorker::runSlice()
+{
+    if (!m_isRunning)
+        return;
+    if (m_pauseRequested->loadAcquire()) {
+        m_isRunning = false;
+        publish();
+        return;
+    }
+
+    m_cpu.run(SLICE_INSTRUCTIONS);
+    if (m_cpu.stopReason() != HackCpu::BUDGET)
+        m_isRunning = false;
+    publish();
+    if (m_isRunning)
+        QMetaObject::invokeMethod(this, [this]() { runSlice(); }, Qt::QueuedConnection);
+}
+
+void EmulatorWorker::publish()
+{
+    EmulatorSnapshot& snapshot = m_snapshots->writeBuffer();
+    snapshot.command = m_command;
+    snapshot.isRunning = m_isRunning;
+    snapshot.stopReason = m_cpu.stopReason();
+    snapshot.watchpointAddress = m_cpu.watchpointAddress();
+    snapshot.a = m_cpu.a();
+    snapshot.d = m_cpu.d();
+    snapshot.pc = m_cpu.pc();
+    snapshot.instructionCount = m_cpu.instructionCount();
+    const quint16 *ram = m_cpu.ramContents().constData();
+    for (int window = 0; window < EmulatorSnapshot::RAM_WINDOW_COUNT; window++) {
+        EmulatorSnapshot::RamWindow& ramWindow = snapshot.ramWindows[window];
+        ramWindow.first = m_ramWindows[window];
+        for (int i = 0; i < EmulatorSnapshot::RAM_WINDOW_SIZE; i++)
+            ramWindow.words[i] = ram[ramWindow.first + i];
+    }
+    m_snapshots->publish();
+}
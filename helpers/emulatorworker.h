@@ -0,0 +1,45 @@
+#ifndef EMULATORWORKER_H
+#define EMULATORWORKER_H
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QVector>
+
+#include "emulatorsnapshot.h"
+#include "triplebuffer.h"
+#include "hackemulator/hackcpu.h"
+
+// Owns the HackCpu and runs it on a thread of its own, in slices of
+// SLICE_INSTRUCTIONS. Between slices it handles the commands queued to it,
+// and checks whether a pause was asked for, so running never waits for the
+// UI and the UI never waits for a slice. Its state goes out through the
+// snapshot buffer. Commands carry a number, reported back in the snapshot.
+class EmulatorWorker : public QObject
+{
+    Q_OBJECT
+public:
+    EmulatorWorker(const QAtomicInt *pauseRequested, TripleBuffer<EmulatorSnapshot> *snapshots);
+
+    void loadProgram(int command, const QVector<quint16>& program);
+    void reset(int command);
+    void run(int command);
+    void step(int command);
+    void setBreakpoint(int command, int address, bool enabled);
+    void setWatchpoint(int command, int address, bool enabled);
+    void setRamWindow(int command, int window, int first);
+
+private:
+    void runSlice();
+    void publish();
+
+    static const qint64 SLICE_INSTRUCTIONS;
+
+    HackCpu m_cpu;
+    const QAtomicInt *m_pauseRequested;
+    TripleBuffer<EmulatorSnapshot> *m_snapshots;
+    int m_command;
+    bool m_isRunning;
+    int m_ramWindows[EmulatorSnapshot::RAM_WINDOW_COUNT];
+};
+
+#endif // EMULATORWORKER_H
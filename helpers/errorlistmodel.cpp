@@ -0,0 +1,137 @@
+#include <QTextBlock>
+
+#include "errorlistmodel.h"
+
+namespace {
+
+inline bool isSameError(const Assembler::Error& a, const Assembler::Error& b)
+{
+    return a.line == b.line && a.type == b.type && a.column == b.column && a.length == b.length;
+}
+
+} // namespace
+
+ErrorListModel::ErrorListModel(const QTextDocument *document, QObject *parent)
+    : QAbstractListModel(parent),
+      m_document(document),
+      m_shiftedFirstRow(0),
+      m_lineShift(0)
+{
+}
+
+/**
+ * Only the rows between the common first and last errors are replaced,
+ * inserted or removed. Any row may still read differently, since messages
+ * quote the edited source, so all of them are reported as changed; the
+ * view only repaints the visible ones.
+ */
+bool ErrorListModel::setErrors(const Assembler::ErrorList& errors)
+{
+    moveShiftedFirstRow(m_errors.size());
+    m_shiftedFirstRow = 0;
+    m_lineShift = 0;
+
+    const int oldCount = m_errors.size();
+    const int newCount = errors.size();
+    int prefix = 0;
+    while (prefix < oldCount && prefix < newCount && isSameError(m_errors.at(prefix), errors.at(prefix)))
+        prefix++;
+    int suffix = 0;
+    while (suffix < oldCount - prefix && suffix < newCount - prefix
+           && isSameError(m_errors.at(oldCount - 1 - suffix), errors.at(newCount - 1 - suffix)))
+        suffix++;
+
+    const int oldChanged = oldCount - prefix - suffix;
+    const int newChanged = newCount - prefix - suffix;
+    if (newChanged > oldChanged) {
+        beginInsertRows(QModelIndex(), prefix + oldChanged, prefix + newChanged - 1);
+        m_errors = errors;
+        endInsertRows();
+    } else if (newChanged < oldChanged) {
+        beginRemoveRows(QModelIndex(), prefix + newChanged, prefix + oldChanged - 1);
+        m_errors = errors;
+        endRemoveRows();
+    } else {
+        m_errors = errors;
+    }
+
+    if (newCount > 0)
+        emit dataChanged(index(0), index(newCount - 1), QVector<int>() << Qt::DisplayRole);
+    return oldChanged > 0 || newChanged > 0;
+}
+
+/**
+ * Only the rows between the previous edit and this one are updated; the
+ * shift of the rows after them just changes. Errors on removed lines move
+ * up to the last line that replaced them, which keeps the rows sorted.
+ */
+void ErrorListModel::shiftLines(int firstLine, int removedCount, int addedCount)
+{
+    const int firstRow = rowForLine(firstLine);
+    const int endRow = rowForLine(firstLine + removedCount);
+    if (addedCount == removedCount && firstRow == endRow)
+        return;
+
+    moveShiftedFirstRow(endRow);
+    m_lineShift += addedCount - removedCount;
+    const int lastLine = qMax(firstLine, firstLine + addedCount - 1);
+    for (int row = firstRow; row < endRow; row++)
+        m_errors[row].line = qMin(m_errors.at(row).line, lastLine);
+
+    if (firstRow < m_errors.size())
+        emit dataChanged(index(firstRow), index(m_errors.size() - 1), QVector<int>() << Qt::DisplayRole);
+}
+
+int ErrorListModel::errorLine(int row) const
+{
+    return m_errors.at(row).line + (row >= m_shiftedFirstRow ? m_lineShift : 0);
+}
+
+int ErrorListModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : m_errors.size();
+}
+
+QVariant ErrorListModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_errors.size() || role != Qt::DisplayRole)
+        return QVariant();
+
+    const Assembler::Error& error = m_errors.at(index.row());
+    const int line = errorLine(index.row());
+    QString formattedLine = QString::number(line + 1).rightJustified(3, ' ');
+    QString message = error.message(m_document->findBlockByNumber(line).text());
+    return QString("%1: %2").arg(formattedLine).arg(message);
+}
+
+/**
+ * The first row whose error is on line or after it.
+ */
+int ErrorListModel::rowForLine(int line) const
+{
+    int first = 0;
+    int count = m_errors.size();
+    while (count > 0) {
+        int step = count / 2;
+        if (errorLine(first + step) < line) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+    return first;
+}
+
+/**
+ * Moves the start of the shifted rows to row, applying the shift to the
+ * rows that leave it or taking it back from the rows that join it.
+ */
+void ErrorListModel::moveShiftedFirstRow(int row)
+{
+    for (int r = m_shiftedFirstRow; r < row; r++)
+        m_errors[r].line += m_lineShift;
+    for (int r = row; r < m_shiftedFirstRow; r++)
+        m_errors[r].line -= m_lineShift;
+    m_shiftedFirstRow = row;
+}
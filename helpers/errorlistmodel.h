@@ -0,0 +1,41 @@
+#ifndef ERRORLISTMODEL_H
+#define ERRORLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QTextDocument>
+
+#include "hackassembler/assembler.h"
+
+// The assembly errors as a list model. New errors only replace the rows
+// that differ from the current ones, and a message is only formatted when
+// the view asks for it, from the text of its line in the document.
+// Edits shift the lines of the errors after them until the edited source
+// is assembled; the rows past the latest edit share one pending shift.
+class ErrorListModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    explicit ErrorListModel(const QTextDocument *document, QObject *parent = 0);
+
+    // Whether any error differs from the ones shown.
+    bool setErrors(const Assembler::ErrorList& errors);
+    // removedCount lines from firstLine were replaced by addedCount lines.
+    void shiftLines(int firstLine, int removedCount, int addedCount);
+
+    int errorLine(int row) const;
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+private:
+    int rowForLine(int line) const;
+    void moveShiftedFirstRow(int row);
+
+    const QTextDocument *m_document;
+    Assembler::ErrorList m_errors;
+    // Rows from m_shiftedFirstRow on are m_lineShift lines further down.
+    int m_shiftedFirstRow;
+    int m_lineShift;
+};
+
+#endif // ERRORLISTMODEL_H
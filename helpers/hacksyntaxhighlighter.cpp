@@ -1,46 +1,72 @@
 #include "hacksyntaxhighlighter.h"
 
+const int HackSyntaxHighlighter::COMMAND_TYPE_MASK = 0x0f;
+const int HackSyntaxHighlighter::ERROR_STATE = 0x10;
+
 HackSyntaxHighlighter::HackSyntaxHighlighter(QTextDocument *parent)
     : QSyntaxHighlighter(parent)
 {
-    HighlightingRule rule;
-
     // Comment
     m_commentFormat.setFontItalic(true);
     m_commentFormat.setForeground(Qt::lightGray);
-    rule.pattern = QRegExp("(?:.*)//.*$");
-    rule.format = m_commentFormat;
-    m_highlightingRules.append(rule);
 
     // Label
-    m_labelInstructionFormat.setFontItalic(true);
-    m_labelInstructionFormat.setForeground(Qt::darkCyan);
-    rule.pattern = QRegExp("(?:^\\s*)\\([A-Za-z0-9_]+\\)(?:\\s*(//.*)?$)");
-    rule.format = m_labelInstructionFormat;
-    m_highlightingRules.append(rule);
+    m_commandFormats[Lexer::L_COMMAND].setFontItalic(true);
+    m_commandFormats[Lexer::L_COMMAND].setForeground(Qt::darkCyan);
 
     // A-Instruction
-    m_AInstructionFormat.setForeground(Qt::darkBlue);
-    rule.pattern = QRegExp("^(?:\\s*)@[A-Za-z0-9_]+(?:\\s*(//.*)?)");
-    rule.format = m_AInstructionFormat;
-    m_highlightingRules.append(rule);
+    m_commandFormats[Lexer::A_COMMAND].setForeground(Qt::darkBlue);
 
     // C-Instruction
-    m_CInstructionFormat.setForeground(Qt::darkGreen);
-    rule.pattern = QRegExp("(?:^\\s*)((M|D|MD|A|AM|AD|AMD)=)?(0|[-]?1|[-!]?[DAM]|[DAM][+-]1|D[+\\-\\&\\|][AM]|[AM]-D)(;J(GT|EQ|GE|LT|NE|LE|MP))?(?:\\s*(//.*)?$)");
-    rule.format = m_CInstructionFormat;
-    m_highlightingRules.append(rule);
+    m_commandFormats[Lexer::C_COMMAND].setForeground(Qt::darkGreen);
+
+    // Invalid field of any of them
+    for (int type = Lexer::NO_COMMAND; type <= Lexer::L_COMMAND; type++) {
+        m_errorFormats[type] = m_commandFormats[type];
+        m_errorFormats[type].setUnderlineStyle(QTextCharFormat::SpellCheckUnderline);
+        m_errorFormats[type].setUnderlineColor(Qt::red);
+    }
+}
+
+Lexer::CommandType HackSyntaxHighlighter::commandType(const QTextBlock& block)
+{
+    int state = block.userState();
+    return state < 0 ? Lexer::NO_COMMAND : Lexer::CommandType(state & COMMAND_TYPE_MASK);
+}
+
+bool HackSyntaxHighlighter::hasError(const QTextBlock& block)
+{
+    int state = block.userState();
+    return state >= 0 && (state & ERROR_STATE);
 }
 
+/**
+ * One lexer pass per block; every span to format is a view of the text.
+ * Lines do not depend on each other, so the state only changes with the
+ * block's own command, and rehighlighting stops right after the edited
+ * blocks instead of running on through the unchanged ones.
+ */
 void HackSyntaxHighlighter::highlightBlock(const QString &text)
 {
-    foreach (const HighlightingRule &rule, m_highlightingRules) {
-        QRegExp expression(rule.pattern);
-        int index = expression.indexIn(text);
-        while (index >= 0) {
-            int length = expression.matchedLength();
-            setFormat(index, length, rule.format);
-            index = expression.indexIn(text, index + length);
-        }
+    const Lexer::Line line = Lexer::lex(QStringView(text));
+    const QChar *begin = text.constData();
+
+    if (!line.command.isEmpty()) {
+        setFormat(int(line.command.data() - begin), int(line.command.size()),
+                  m_commandFormats[line.commandType]);
+    }
+
+    if (line.hasError()) {
+        // An empty field, like the destination of "=D", is wrong as a whole.
+        QStringView errorText = line.errorText.isEmpty() ? line.command : line.errorText;
+        setFormat(int(errorText.data() - begin), int(errorText.size()),
+                  m_errorFormats[line.commandType]);
+    }
+
+    if (!line.comment.isEmpty()) {
+        setFormat(int(line.comment.data() - begin), int(line.comment.size()),
+                  m_commentFormat);
     }
+
+    setCurrentBlockState(line.commandType | (line.hasError() ? ERROR_STATE : 0));
 }
@@ -1,31 +1,34 @@
 #ifndef HACKSYNTAXHIGHLIGHTER_H
 #define HACKSYNTAXHIGHLIGHTER_H
 
-#include <QRegExp>
 #include <QSyntaxHighlighter>
+#include <QTextBlock>
 #include <QTextCharFormat>
-#include <QVector>
 
+#include "hackassembler/lexer.h"
+
+// Highlights Hack assembly with the assembler's own lexer, so that what is
+// coloured as an instruction is what translates as one. Invalid fields are
+// underlined. What a block holds is kept as its user state.
 class HackSyntaxHighlighter : public QSyntaxHighlighter
 {
 public:
     HackSyntaxHighlighter(QTextDocument *parent = 0);
 
-    void highlightBlock(const QString &text);
+    // What the block held when it was last highlighted.
+    static Lexer::CommandType commandType(const QTextBlock& block);
+    static bool hasError(const QTextBlock& block);
 
-private:
-    struct HighlightingRule
-    {
-        QRegExp pattern;
-        QTextCharFormat format;
-    };
+protected:
+    void highlightBlock(const QString &text) Q_DECL_OVERRIDE;
 
-    QVector<HighlightingRule> m_highlightingRules;
+private:
+    static const int COMMAND_TYPE_MASK;
+    static const int ERROR_STATE;
 
     QTextCharFormat m_commentFormat;
-    QTextCharFormat m_labelInstructionFormat;
-    QTextCharFormat m_AInstructionFormat;
-    QTextCharFormat m_CInstructionFormat;
+    QTextCharFormat m_commandFormats[Lexer::L_COMMAND + 1];
+    QTextCharFormat m_errorFormats[Lexer::L_COMMAND + 1];
 };
 
 #endif // HACKSYNTAXHIGHLIGHTER_H
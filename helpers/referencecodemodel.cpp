@@ -0,0 +1,231 @@
+#include <QBrush>
+#include <QColor>
+
+#include "referencecodemodel.h"
+
+ReferenceCodeModel::ReferenceCodeModel(QObject *parent)
+    : QAbstractListModel(parent),
+      m_translatedLineCount(0),
+      m_aligned(false)
+{
+}
+
+bool ReferenceCodeModel::open(const QString& filename)
+{
+    beginResetModel();
+    const bool opened = m_file.open(filename);
+    m_referenceCode.clear();
+    m_invalidRows.clear();
+    updateDiff(false);
+    endResetModel();
+    return opened;
+}
+
+void ReferenceCodeModel::close()
+{
+    beginResetModel();
+    m_file.close();
+    m_referenceCode.clear();
+    m_invalidRows.clear();
+    updateDiff(false);
+    endResetModel();
+}
+
+/**
+ * Only the lines whose comparison may have changed are updated: those past
+ * the shorter of the old and new counts, or all of them for other code.
+ * Aligned, other code is aligned again as a whole and resets the rows,
+ * while more or fewer lines of the same code only change the colour of
+ * the rows between the old and new last translated line.
+ */
+void ReferenceCodeModel::setTranslatedCode(const QVector<quint16>& code, int lineCount)
+{
+    const bool sameCode = m_translatedCode.constData() == code.constData()
+            && m_translatedCode.size() == code.size();
+    if (m_aligned) {
+        if (!sameCode) {
+            beginResetModel();
+            m_translatedCode = code;
+            m_translatedLineCount = lineCount;
+            updateDiff(false);
+            endResetModel();
+            return;
+        }
+        const int oldRowCount = comparedRowCount();
+        m_translatedLineCount = lineCount;
+        const int newRowCount = comparedRowCount();
+        if (oldRowCount != newRowCount)
+            emit dataChanged(index(qMin(oldRowCount, newRowCount)), index(qMax(oldRowCount, newRowCount) - 1),
+                             QVector<int>() << Qt::ForegroundRole);
+        return;
+    }
+
+    const int firstChanged = sameCode ? qMin(m_translatedLineCount, lineCount) : 0;
+    const int lastChanged = qMin(qMax(m_translatedLineCount, lineCount), m_file.rowCount()) - 1;
+    m_translatedCode = code;
+    m_translatedLineCount = lineCount;
+    updateDiff(sameCode);
+    if (firstChanged <= lastChanged)
+        emit dataChanged(index(firstChanged), index(lastChanged), QVector<int>() << Qt::ForegroundRole);
+}
+
+void ReferenceCodeModel::setAligned(bool aligned)
+{
+    if (aligned == m_aligned)
+        return;
+    beginResetModel();
+    m_aligned = aligned;
+    updateDiff(false);
+    endResetModel();
+}
+
+int ReferenceCodeModel::translatedLine(int row) const
+{
+    return isAligned() ? m_alignment.leftLine(row) : row;
+}
+
+int ReferenceCodeModel::referenceLine(int row) const
+{
+    return isAligned() ? m_alignment.rightLine(row) : row;
+}
+
+int ReferenceCodeModel::rowForTranslatedLine(int line) const
+{
+    if (line < 0)
+        return -1;
+    return isAligned() ? m_alignment.rowForLeftLine(line) : line;
+}
+
+/**
+ * A reference line that is not a valid instruction differs from any
+ * translated one. Aligned, the rows of a change differ, gaps included.
+ */
+ReferenceCodeModel::RowState ReferenceCodeModel::rowState(int row) const
+{
+    if (isAligned()) {
+        if (row >= comparedRowCount())
+            return NOT_COMPARED;
+        return m_alignment.isMismatch(row) ? DIFFERING : MATCHING;
+    }
+    if (row >= m_diff.comparedCount())
+        return NOT_COMPARED;
+    return m_diff.isMismatch(row) ? DIFFERING : MATCHING;
+}
+
+int ReferenceCodeModel::mismatchCount() const
+{
+    return isAligned() ? m_alignment.mismatchCountBefore(comparedRowCount()) : m_diff.mismatchCount();
+}
+
+int ReferenceCodeModel::nextMismatch(int row) const
+{
+    if (!isAligned())
+        return m_diff.nextMismatch(row);
+    const int mismatch = m_alignment.nextMismatch(row);
+    return mismatch < comparedRowCount() ? mismatch : -1;
+}
+
+int ReferenceCodeModel::previousMismatch(int row) const
+{
+    if (!isAligned())
+        return m_diff.previousMismatch(row);
+    return m_alignment.previousMismatch(qMin(row, comparedRowCount()));
+}
+
+/**
+ * The rows of the alignment up to the first untranslated line, gaps on the
+ * translated side before it included.
+ */
+int ReferenceCodeModel::comparedRowCount() const
+{
+    if (!isAligned())
+        return 0;
+    if (m_translatedLineCount >= m_translatedCode.size())
+        return m_alignment.rowCount();
+    return m_alignment.rowForLeftLine(m_translatedLineCount);
+}
+
+/**
+ * More lines of the same translation are only compared, and reference rows
+ * only decoded, from where the previous comparison ended. An alignment
+ * needs the whole reference and the whole translation, and is computed
+ * again from scratch.
+ */
+void ReferenceCodeModel::updateDiff(bool sameCode)
+{
+    m_alignment.clear();
+    if (m_aligned) {
+        m_diff.clear();
+        if (!m_translatedCode.isEmpty() && m_file.rowCount() > 0) {
+            decodeReference(m_file.rowCount());
+            m_alignment.compare(m_translatedCode.constData(), m_translatedCode.size(),
+                                m_referenceCode.constData(), m_referenceCode.size(), m_invalidRows);
+        }
+        return;
+    }
+
+    const int comparedCount = qMin(m_translatedLineCount, m_file.rowCount());
+    if (comparedCount == 0) {
+        m_diff.clear();
+        return;
+    }
+
+    decodeReference(comparedCount);
+    if (sameCode && comparedCount >= m_diff.comparedCount())
+        m_diff.extend(m_translatedCode.constData(), m_referenceCode.constData(), comparedCount, m_invalidRows);
+    else
+        m_diff.compare(m_translatedCode.constData(), m_referenceCode.constData(), comparedCount, m_invalidRows);
+}
+
+void ReferenceCodeModel::decodeReference(int lineCount)
+{
+    const int decodedCount = m_referenceCode.size();
+    if (lineCount <= decodedCount)
+        return;
+    m_referenceCode.resize(lineCount);
+    m_file.decodeInstructions(decodedCount, lineCount - decodedCount,
+                              m_referenceCode.data() + decodedCount, &m_invalidRows);
+}
+
+int ReferenceCodeModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return isAligned() ? m_alignment.rowCount() : m_file.rowCount();
+}
+
+QVariant ReferenceCodeModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount())
+        return QVariant();
+
+    const int line = referenceLine(index.row());
+    switch (role) {
+    case Qt::DisplayRole: {
+        if (line < 0)
+            return QString();
+        QString text = m_file.rowText(line);
+        if (text.size() == 16)
+            text.insert(12, ' ').insert(8, ' ').insert(4, ' ');
+        return text;
+    }
+
+    case Qt::ForegroundRole:
+        switch (rowState(index.row())) {
+        case MATCHING:
+            return QBrush(Qt::darkGreen);
+        case DIFFERING:
+            return QBrush(Qt::red);
+        default:
+            return QVariant();
+        }
+
+    case Qt::BackgroundRole:
+        if (line < 0)
+            return QBrush(QColor(Qt::lightGray).lighter(115));
+        return QVariant();
+
+    default:
+        return QVariant();
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef REFERENCECODEMODEL_H
+#define REFERENCECODEMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+
+#include "hackassembler/aligneddiff.h"
+#include "hackassembler/binarydiff.h"
+#include "hackassembler/hackbinaryfile.h"
+
+// The reference .hack file as a list model. Rows are read from the mapped
+// file when the view asks for them, and coloured by whether they match the
+// translated instruction on the same row.
+// By default row n holds line n of either program, compared as a
+// BinaryDiff; reference rows are then only decoded as far as there are
+// translated lines to compare them with. Aligned, the rows follow an
+// AlignedDiff of the whole translation and the reference instead, with gaps
+// for lines that only one of them has, and are only compared up to the
+// last translated line. The translated code model takes its rows from here
+// then.
+class ReferenceCodeModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum RowState {
+        NOT_COMPARED,
+        MATCHING,
+        DIFFERING
+    };
+
+    explicit ReferenceCodeModel(QObject *parent = 0);
+
+    bool open(const QString& filename);
+    void close();
+
+    int lineCount() const { return m_file.rowCount(); }
+    QString lineText(int line) const { return m_file.rowText(line); }
+
+    // The first lineCount instructions of code get compared. Aligned, all
+    // of code is aligned, once per buffer.
+    void setTranslatedCode(const QVector<quint16>& code, int lineCount);
+
+    void setAligned(bool aligned);
+    // Whether rows currently follow the alignment, which needs lines on
+    // both sides.
+    bool isAligned() const { return m_alignment.rowCount() > 0; }
+
+    // The line shown on a row, or -1 for a gap.
+    int translatedLine(int row) const;
+    int referenceLine(int row) const;
+    int rowForTranslatedLine(int line) const;
+
+    RowState rowState(int row) const;
+    int mismatchCount() const;
+    // The closest differing row after or before row, or -1.
+    int nextMismatch(int row) const;
+    int previousMismatch(int row) const;
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+private:
+    void updateDiff(bool sameCode);
+    // Aligned, the rows before the first untranslated line.
+    int comparedRowCount() const;
+    void decodeReference(int lineCount);
+
+    HackBinaryFile m_file;
+    // The first rows of the file, decoded.
+    QVector<quint16> m_referenceCode;
+    QVector<int> m_invalidRows;
+
+    QVector<quint16> m_translatedCode;
+    int m_translatedLineCount;
+    bool m_aligned;
+    BinaryDiff m_diff;
+    AlignedDiff m_alignment;
+};
+
+#endif // REFERENCECODEMODEL_H
@@ -0,0 +1,155 @@
+#include <QBrush>
+#include <QColor>
+#include <cstring>
+
+#include "hackassembler/code.h"
+#include "translatedcodemodel.h"
+
+namespace {
+
+/**
+ * The 16 digits in groups of four, as "0000 0000 0000 0000".
+ */
+QString displayText(quint16 instruction)
+{
+    char digits[16];
+    Code::writeBinaryString(instruction, digits);
+
+    char text[19];
+    for (int group = 0; group < 4; group++) {
+        memcpy(text + group * 5, digits + group * 4, 4);
+        if (group < 3)
+            text[group * 5 + 4] = ' ';
+    }
+    return QString::fromLatin1(text, sizeof(text));
+}
+
+} // namespace
+
+TranslatedCodeModel::TranslatedCodeModel(const ReferenceCodeModel *referenceCodeModel, QObject *parent)
+    : QAbstractListModel(parent),
+      m_referenceCodeModel(referenceCodeModel),
+      m_lineCount(0)
+{
+    connect(m_referenceCodeModel, &QAbstractItemModel::dataChanged,
+            this, &TranslatedCodeModel::referenceDataChanged);
+    connect(m_referenceCodeModel, &QAbstractItemModel::modelAboutToBeReset,
+            this, &TranslatedCodeModel::referenceAboutToBeReset);
+    connect(m_referenceCodeModel, &QAbstractItemModel::modelReset,
+            this, &TranslatedCodeModel::referenceReset);
+}
+
+/**
+ * Stepping through a translation shows one more line of the same code at a
+ * time, which only inserts the new rows. Aligned, the rows of the whole
+ * code are there already and the new lines only fill theirs in. The buffer
+ * is shared with the assembler's, not copied.
+ */
+void TranslatedCodeModel::setTranslatedCode(const QVector<quint16>& code, int lineCount)
+{
+    Q_ASSERT(lineCount <= code.size());
+    const bool sameBuffer = m_code.constData() == code.constData() && m_code.size() == code.size();
+    const bool sameCode = m_lineCount == 0 || sameBuffer;
+    if (lineCount > m_lineCount && sameCode && !m_referenceCodeModel->isAligned()) {
+        beginInsertRows(QModelIndex(), m_lineCount, lineCount - 1);
+        m_code = code;
+        m_lineCount = lineCount;
+        endInsertRows();
+    } else if (lineCount != m_lineCount && sameBuffer && m_referenceCodeModel->isAligned()) {
+        const int firstRow = rowForLine(qMin(m_lineCount, lineCount));
+        const int lastRow = rowForLine(qMax(m_lineCount, lineCount) - 1);
+        m_lineCount = lineCount;
+        emit dataChanged(index(firstRow), index(lastRow));
+        emit linesChanged();
+    } else if (lineCount != m_lineCount || !sameCode) {
+        beginResetModel();
+        m_code = code;
+        m_lineCount = lineCount;
+        endResetModel();
+    }
+}
+
+void TranslatedCodeModel::clear()
+{
+    setTranslatedCode(QVector<quint16>(), 0);
+}
+
+int TranslatedCodeModel::lineForRow(int row) const
+{
+    if (row < 0)
+        return -1;
+    return m_referenceCodeModel->translatedLine(row);
+}
+
+int TranslatedCodeModel::rowForLine(int line) const
+{
+    return m_referenceCodeModel->rowForTranslatedLine(line);
+}
+
+int TranslatedCodeModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_referenceCodeModel->isAligned() ? m_referenceCodeModel->rowCount() : m_lineCount;
+}
+
+/**
+ * Aligned, the rows of lines not translated yet are left empty. While the
+ * reference model has not caught up with new code yet, its alignment may
+ * name lines that are gone; those are left empty too.
+ */
+QVariant TranslatedCodeModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount())
+        return QVariant();
+
+    const int line = lineForRow(index.row());
+    const bool isGap = line < 0 || line >= m_code.size();
+    switch (role) {
+    case Qt::DisplayRole:
+        return isGap || line >= m_lineCount ? QString() : displayText(m_code.at(line));
+
+    case Qt::ForegroundRole:
+        switch (m_referenceCodeModel->rowState(index.row())) {
+        case ReferenceCodeModel::MATCHING:
+            return QBrush(Qt::darkGreen);
+        case ReferenceCodeModel::DIFFERING:
+            return QBrush(Qt::red);
+        default:
+            return QBrush(Qt::darkGray);
+        }
+
+    case Qt::BackgroundRole:
+        if (isGap)
+            return QBrush(QColor(Qt::lightGray).lighter(115));
+        return QVariant();
+
+    default:
+        return QVariant();
+    }
+}
+
+/**
+ * The comparison of a line changed on the reference side, so the line
+ * changes colour on this side too.
+ */
+void TranslatedCodeModel::referenceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight)
+{
+    const int lastRow = qMin(bottomRight.row(), rowCount() - 1);
+    if (topLeft.row() <= lastRow)
+        emit dataChanged(index(topLeft.row()), index(lastRow), QVector<int>() << Qt::ForegroundRole);
+}
+
+/**
+ * The reference may have been opened, or aligned, or aligned again with
+ * new code; with an alignment the rows here change along with it.
+ */
+void TranslatedCodeModel::referenceAboutToBeReset()
+{
+    beginResetModel();
+}
+
+void TranslatedCodeModel::referenceReset()
+{
+    endResetModel();
+}
@@ -0,0 +1,50 @@
+#ifndef TRANSLATEDCODEMODEL_H
+#define TRANSLATEDCODEMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+
+#include "referencecodemodel.h"
+
+// The translated instructions as a list model. It shares the assembler's
+// instruction buffer and shows its first lines; a row is only formatted
+// when the view asks for it. Rows are coloured by comparison with the
+// reference, and follow the reference model's rows while it is aligned.
+class TranslatedCodeModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    explicit TranslatedCodeModel(const ReferenceCodeModel *referenceCodeModel, QObject *parent = 0);
+
+    // Shows the first lineCount instructions of code. Growing the count
+    // over the same code inserts rows, or while aligned changes the rows of
+    // the lines shown or hidden and emits linesChanged(); anything else
+    // resets the model.
+    void setTranslatedCode(const QVector<quint16>& code, int lineCount);
+    void clear();
+
+    const QVector<quint16>& code() const { return m_code; }
+    int lineCount() const { return m_lineCount; }
+    // The line shown on a row, or -1 for a gap, and the other way around.
+    int lineForRow(int row) const;
+    int rowForLine(int line) const;
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+signals:
+    // The line count changed without inserting rows or a reset.
+    void linesChanged();
+
+private slots:
+    void referenceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+    void referenceAboutToBeReset();
+    void referenceReset();
+
+private:
+    const ReferenceCodeModel *m_referenceCodeModel;
+    QVector<quint16> m_code;
+    int m_lineCount;
+};
+
+#endif // TRANSLATEDCODEMODEL_H
@@ -0,0 +1,46 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <QAtomicInt>
+
+// Hands the latest of a stream of values from one writer thread to one
+// reader thread without locking or allocating. Each side owns one of three
+// buffers; the third is swapped with an atomic exchange, by the writer to
+// publish a value and by the reader to take the latest one. Neither side
+// ever waits for the other, and values the reader had no time for are
+// skipped.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : m_buffers(), m_writeIndex(0), m_shared(1), m_readIndex(2) {}
+
+    // Writer: fill in writeBuffer(), then publish() it.
+    T& writeBuffer() { return m_buffers[m_writeIndex]; }
+    void publish() { m_writeIndex = m_shared.fetchAndStoreAcqRel(m_writeIndex | FRESH) & INDEX_MASK; }
+
+    // Reader: update() takes the latest value published, if there is a new
+    // one, as readBuffer().
+    bool update()
+    {
+        if (!(m_shared.loadAcquire() & FRESH))
+            return false;
+        m_readIndex = m_shared.fetchAndStoreAcqRel(m_readIndex) & INDEX_MASK;
+        return true;
+    }
+    const T& readBuffer() const { return m_buffers[m_readIndex]; }
+
+private:
+    Q_DISABLE_COPY(TripleBuffer)
+
+    enum { INDEX_MASK = 3, FRESH = 4 };
+
+    T m_buffers[3];
+    int m_writeIndex;
+    // The index of the buffer between the two, and whether it holds a value
+    // the reader has not taken yet.
+    QAtomicInt m_shared;
+    int m_readIndex;
+};
+
+#endif // TRIPLEBUFFER_H
@@ -1,23 +1,55 @@
+#include <algorithm>
+
 #include <QClipboard>
 #include <QFileDialog>
 #include <QGuiApplication>
+#include <QInputDialog>
 #include <QMessageBox>
 #include <QScrollBar>
 #include <QSettings>
+#include <QStatusBar>
+#include <QTextBlock>
 #include <QTextStream>
+#include <QTimer>
 
 #include "hackassemblereditor.h"
+#include "hackassembler/code.h"
+#include "hackassembler/mappedfile.h"
 #include "ui_hackassemblereditor.h"
 
 const int HackAssemblerEditor::DEFAULT_SPEED = 2;
+const int HackAssemblerEditor::DEFAULT_REASSEMBLY_DELAY = 150;
+const int HackAssemblerEditor::MAX_REASSEMBLY_DELAY = 5000;
 
 HackAssemblerEditor::HackAssemblerEditor(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
-    m_about(NULL)
+    m_about(NULL),
+    m_emulatedPc(-1),
+    m_pendingEmulatorCommand(NO_EMULATOR_COMMAND),
+    m_sourceLineCount(0),
+    m_reassemblyTimer(NULL),
+    m_pendingFirstLine(-1),
+    m_pendingOldEnd(0),
+    m_pendingNewEnd(0),
+    m_pendingWholeSource(false),
+    m_coalescedEditCount(0),
+    m_coalescedEditsLabel(NULL)
 {
     ui->setupUi(this);
 
+    QSettings settings;
+
+    m_reassemblyTimer = new QTimer(this);
+    m_reassemblyTimer->setSingleShot(true);
+    m_reassemblyTimer->setInterval(settings.value("assembler/reassemblyDelay", DEFAULT_REASSEMBLY_DELAY).toInt());
+    connect(m_reassemblyTimer, &QTimer::timeout, this, &HackAssemblerEditor::flushSourceEdits);
+
+    m_coalescedEditsLabel = new QLabel(this);
+    m_coalescedEditsLabel->setToolTip(tr("Edits made while others were waiting to be assembled, "
+                                         "and assembled together with them"));
+    statusBar()->addPermanentWidget(m_coalescedEditsLabel);
+
     m_hackSyntaxHighlighter = new HackSyntaxHighlighter(ui->sourceTextEdit->document());
 
     connect(ui->sourceTextEdit, &QPlainTextEdit::cursorPositionChanged,
@@ -28,10 +60,44 @@ HackAssemblerEditor::HackAssemblerEditor(QWidget *parent) :
             this, &HackAssemblerEditor::asmControllerStateChanged);
     connect(m_asmController, &AssemblerController::currentLineChanged,
             this, &HackAssemblerEditor::asmControllerCurrentLineChanged);
-
-    connect(ui->translatedCode->model(), &QAbstractItemModel::rowsInserted,
+    connect(m_asmController, &AssemblerController::translationRateChanged,
+            this, &HackAssemblerEditor::asmControllerTranslationRateChanged);
+    connect(m_asmController, &AssemblerController::assembled,
+            this, &HackAssemblerEditor::asmControllerAssembled);
+
+    m_emulatorController = new EmulatorController(this);
+    connect(m_emulatorController, &EmulatorController::updated,
+            this, &HackAssemblerEditor::emulatorUpdated);
+    connect(m_emulatorController, &EmulatorController::runningChanged,
+            this, &HackAssemblerEditor::emulatorRunningChanged);
+    connect(m_emulatorController, &EmulatorController::instructionRateChanged,
+            this, &HackAssemblerEditor::emulatorInstructionRateChanged);
+    m_emulatorController->setRamWindow(1, ui->ramWindowSpinBox->value());
+    updateBreakpointsLabel();
+
+    m_sourceLineCount = ui->sourceTextEdit->document()->blockCount();
+    connect(ui->sourceTextEdit->document(), &QTextDocument::contentsChange,
+            this, &HackAssemblerEditor::sourceContentsChange);
+
+    m_errorListModel = new ErrorListModel(ui->sourceTextEdit->document(), this);
+    ui->errorList->setModel(m_errorListModel);
+    connect(ui->errorList->selectionModel(), &QItemSelectionModel::currentChanged,
+            this, &HackAssemblerEditor::errorListCurrentChanged);
+
+    m_referenceCodeModel = new ReferenceCodeModel(this);
+    ui->referenceCode->setModel(m_referenceCodeModel);
+    connect(ui->referenceCode->selectionModel(), &QItemSelectionModel::currentChanged,
+            this, &HackAssemblerEditor::referenceCodeCurrentChanged);
+
+    m_translatedCodeModel = new TranslatedCodeModel(m_referenceCodeModel, this);
+    ui->translatedCode->setModel(m_translatedCodeModel);
+    connect(ui->translatedCode->selectionModel(), &QItemSelectionModel::currentChanged,
+            this, &HackAssemblerEditor::translatedCodeCurrentChanged);
+    connect(m_translatedCodeModel, &QAbstractItemModel::rowsInserted,
             this, &HackAssemblerEditor::translatedCodeModelChanged);
-    connect(ui->translatedCode->model(), &QAbstractItemModel::modelReset,
+    connect(m_translatedCodeModel, &QAbstractItemModel::modelReset,
+            this, &HackAssemblerEditor::translatedCodeModelReset);
+    connect(m_translatedCodeModel, &TranslatedCodeModel::linesChanged,
             this, &HackAssemblerEditor::translatedCodeModelReset);
 
     connect(ui->translatedCode->verticalScrollBar(), &QScrollBar::valueChanged,
@@ -39,8 +105,6 @@ HackAssemblerEditor::HackAssemblerEditor(QWidget *parent) :
     connect(ui->referenceCode->verticalScrollBar(), &QScrollBar::valueChanged,
             this, &HackAssemblerEditor::referenceCodeScrollMoved);
 
-    QSettings settings;
-
     QString lastSourceFile = settings.value("editor/asmSrcPath", QString()).toString();
     if (!lastSourceFile.isEmpty())
         openSourceFile(lastSourceFile);
@@ -50,6 +114,7 @@ HackAssemblerEditor::HackAssemblerEditor(QWidget *parent) :
         openReferenceBinaryFile(lastBinaryReferenceFile);
 
     ui->speedSlider->setValue(settings.value("assembler/speed", HackAssemblerEditor::DEFAULT_SPEED).toInt());
+    ui->action_AlignDiff->setChecked(settings.value("editor/alignDiff", false).toBool());
     restoreGeometry(settings.value("editor/geometry").toByteArray());
 
     ui->sourceTextEdit->setFocus();
@@ -70,9 +135,10 @@ void HackAssemblerEditor::closeEvent(QCloseEvent *event)
     QSettings settings;
     settings.setValue("editor/geometry", saveGeometry());
     settings.setValue("assembler/speed", ui->speedSlider->value());
+    settings.setValue("assembler/reassemblyDelay", m_reassemblyTimer->interval());
     settings.sync();
 
-    ui->translatedCode->model()->disconnect();
+    m_translatedCodeModel->disconnect();
     event->accept();
 }
 
@@ -138,7 +204,6 @@ void HackAssemblerEditor::on_action_OpenCmpBinary_triggered()
                                                     tr("Hack Binary Files (*.hack);;All Files (*)"));
     QFileInfo fileInfo = openReferenceBinaryFile(filename);
     if (fileInfo.exists()) {
-        updateBinDiff();
         settings.setValue("editor/binRefDir", fileInfo.absolutePath());
         settings.setValue("editor/refBinPath", fileInfo.absoluteFilePath());
         settings.sync();
@@ -158,9 +223,7 @@ void HackAssemblerEditor::on_action_SaveTranslatedBinary_triggered()
 
     QFile file(filename);
     file.open(QFile::WriteOnly | QFile::Text);
-    QTextStream outStream(&file);
-    for (int i = 0; i < ui->translatedCode->count(); i++)
-        outStream << ui->translatedCode->item(i)->text().replace(" ", "") << "\n";
+    file.write(Code::hackFileContents(translatedBinaryCode()));
 
     QFileInfo fileInfo(filename);
     settings.setValue("editor/binOutDir", fileInfo.absolutePath());
@@ -190,7 +253,7 @@ void HackAssemblerEditor::cursorPositionChanged()
     selection.cursor.clearSelection();
 
     Qt::GlobalColor bgColor(Qt::yellow);
-    if (m_asmController->lineHasError(selection.cursor.blockNumber()))
+    if (HackSyntaxHighlighter::hasError(selection.cursor.block()))
         bgColor = Qt::red;
     QColor lineColor = QColor(bgColor).lighter(160);
     selection.format.setBackground(lineColor);
@@ -199,12 +262,13 @@ void HackAssemblerEditor::cursorPositionChanged()
     ui->sourceTextEdit->setExtraSelections(extraSelections);
 
     int translatedLineNumber = m_asmController->binaryLineForSourceLine(selection.cursor.blockNumber());
-    if (translatedLineNumber != ui->translatedCode->currentRow())
-        ui->translatedCode->setCurrentRow(translatedLineNumber);
+    if (translatedLineNumber != m_translatedCodeModel->lineForRow(ui->translatedCode->currentIndex().row()))
+        setCurrentTranslatedLine(translatedLineNumber);
 }
 
 void HackAssemblerEditor::on_action_RunPauseTranslation_triggered(bool checked)
 {
+    flushSourceEdits();
     if (checked)
         m_asmController->run();
     else
@@ -218,6 +282,7 @@ void HackAssemblerEditor::on_action_RunPauseTranslation_toggled(bool checked)
 
 void HackAssemblerEditor::on_action_StepTranslation_triggered()
 {
+    flushSourceEdits();
     m_asmController->step();
 }
 
@@ -228,13 +293,115 @@ void HackAssemblerEditor::on_action_ResetTranslation_triggered()
 
 void HackAssemblerEditor::on_action_TranslateAll_triggered()
 {
+    flushSourceEdits();
     m_asmController->reset();
     m_asmController->translateAll();
 }
 
+/**
+ * Without a current row, the search starts before the first row or after
+ * the last one. Aligned, a mismatch may be a gap, so rows are searched
+ * rather than lines.
+ */
+void HackAssemblerEditor::on_action_NextMismatch_triggered()
+{
+    int row = m_referenceCodeModel->nextMismatch(ui->translatedCode->currentIndex().row());
+    if (row > -1)
+        ui->translatedCode->setCurrentIndex(m_translatedCodeModel->index(row));
+}
+
+void HackAssemblerEditor::on_action_PreviousMismatch_triggered()
+{
+    int currentRow = ui->translatedCode->currentIndex().row();
+    if (currentRow < 0)
+        currentRow = m_translatedCodeModel->rowCount();
+    int row = m_referenceCodeModel->previousMismatch(currentRow);
+    if (row > -1)
+        ui->translatedCode->setCurrentIndex(m_translatedCodeModel->index(row));
+}
+
+void HackAssemblerEditor::on_action_AlignDiff_toggled(bool checked)
+{
+    m_referenceCodeModel->setAligned(checked);
+    updateMismatchActions();
+
+    QSettings settings;
+    settings.setValue("editor/alignDiff", checked);
+    settings.sync();
+}
+
+void HackAssemblerEditor::on_action_RunPauseEmulation_triggered(bool checked)
+{
+    if (checked) {
+        startEmulation(EMULATOR_RUN);
+    } else {
+        m_pendingEmulatorCommand = NO_EMULATOR_COMMAND;
+        m_emulatorController->pause();
+    }
+}
+
+void HackAssemblerEditor::on_action_StepEmulation_triggered()
+{
+    startEmulation(EMULATOR_STEP);
+}
+
+void HackAssemblerEditor::on_action_ResetEmulation_triggered()
+{
+    m_pendingEmulatorCommand = NO_EMULATOR_COMMAND;
+    m_emulatorController->reset();
+}
+
+/**
+ * Breakpoints are set on the current line of the translated code, by
+ * address, so they stay where they are when the source is edited.
+ */
+void HackAssemblerEditor::on_action_ToggleBreakpoint_triggered()
+{
+    int line = m_translatedCodeModel->lineForRow(ui->translatedCode->currentIndex().row());
+    if (line < 0)
+        return;
+    m_emulatorController->setBreakpoint(line, !m_emulatorController->hasBreakpoint(line));
+    updateBreakpointsLabel();
+}
+
+void HackAssemblerEditor::on_action_ToggleWatchpoint_triggered()
+{
+    bool ok = false;
+    int address = QInputDialog::getInt(this, tr("RAM Watchpoint"), tr("Stop after writes to RAM address:"),
+                                       ui->ramWindowSpinBox->value(), 0, HackCpu::RAM_SIZE - 1, 1, &ok);
+    if (!ok)
+        return;
+    m_emulatorController->setWatchpoint(address, !m_emulatorController->hasWatchpoint(address));
+    updateBreakpointsLabel();
+}
+
+void HackAssemblerEditor::on_ramWindowSpinBox_valueChanged(int value)
+{
+    m_emulatorController->setRamWindow(1, value);
+}
+
+/**
+ * Edits are assembled once typing pauses for this long; 0 assembles every
+ * edit on its own.
+ */
+void HackAssemblerEditor::on_action_ReassemblyDelay_triggered()
+{
+    bool ok = false;
+    int delay = QInputDialog::getInt(this, tr("Reassembly Delay"),
+                                     tr("Assemble edits after a pause in typing of (ms):"),
+                                     m_reassemblyTimer->interval(), 0, MAX_REASSEMBLY_DELAY, 50, &ok);
+    if (!ok)
+        return;
+    m_reassemblyTimer->setInterval(delay);
+
+    QSettings settings;
+    settings.setValue("assembler/reassemblyDelay", delay);
+    settings.sync();
+}
+
 void HackAssemblerEditor::on_speedSlider_valueChanged(int value)
 {
-    static const char * const Speed[] = { "x0.25", "x0.5", "x1", "x1.5", "x2" };
+    static const char * const Speed[] = { "x0.25", "x0.5", "x1", "x1.5", "x2", "Turbo", "Max" };
     ui->speedLabel->setText(Speed[value]);
     m_asmController->setSpeed(AssemblerController::Speed(value));
 }
@@ -245,45 +412,126 @@ void HackAssemblerEditor::on_errorButton_toggled(bool checked)
     ui->errorList->setSizePolicy(QSizePolicy::Expanding, vertical);
 }
 
-void HackAssemblerEditor::on_errorList_currentRowChanged(int currentRow)
+void HackAssemblerEditor::errorListCurrentChanged(const QModelIndex& current)
 {
-    if (currentRow < 0 || m_asmController->errors().empty())
-        return;
-    goToSourceLine(m_asmController->errors().at(currentRow).line);
+    if (current.isValid())
+        goToSourceLine(m_errorListModel->errorLine(current.row()));
 }
 
-void HackAssemblerEditor::on_errorList_itemActivated(QListWidgetItem *item)
+void HackAssemblerEditor::on_errorList_activated(const QModelIndex& index)
 {
-    goToSourceLine(m_asmController->errors().at(ui->errorList->row(item)).line);
+    goToSourceLine(m_errorListModel->errorLine(index.row()));
     ui->sourceTextEdit->setFocus();
 }
 
+/**
+ * Edits are only handed to the assembler once typing pauses for the
+ * reassembly delay, all of them at once; it only re-parses the lines they
+ * touched. The number of lines an edit replaced follows from the change in
+ * the document's line count. In the meantime the translation is outdated,
+ * so it is reset right away.
+ */
+void HackAssemblerEditor::sourceContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved);
+    QTextDocument *document = ui->sourceTextEdit->document();
+    int previousLineCount = m_sourceLineCount;
+    m_sourceLineCount = document->blockCount();
+
+    QTextBlock firstBlock = document->findBlock(position);
+    QTextBlock lastBlock = document->findBlock(position + charsAdded);
+    if (!lastBlock.isValid())
+        lastBlock = document->lastBlock();
+
+    int firstLine = firstBlock.blockNumber();
+    int addedCount = lastBlock.blockNumber() - firstLine + 1;
+    int removedCount = addedCount - (m_sourceLineCount - previousLineCount);
+
+    if (m_pendingWholeSource || m_pendingFirstLine > -1) {
+        m_coalescedEditCount++;
+        m_coalescedEditsLabel->setText(tr("%L1 reassemblies coalesced").arg(m_coalescedEditCount));
+    }
+
+    if (!firstBlock.isValid() || removedCount < 1) {
+        m_pendingWholeSource = true;
+    } else {
+        m_errorListModel->shiftLines(firstLine, removedCount, addedCount);
+        if (m_pendingFirstLine < 0) {
+            m_pendingFirstLine = firstLine;
+            m_pendingOldEnd = firstLine + removedCount;
+            m_pendingNewEnd = firstLine + addedCount;
+        } else {
+            // Both edits, and whatever lines lie between them, become one.
+            int end = qMax(m_pendingNewEnd, firstLine + removedCount);
+            m_pendingOldEnd += end - m_pendingNewEnd;
+            m_pendingNewEnd = end + addedCount - removedCount;
+            m_pendingFirstLine = qMin(m_pendingFirstLine, firstLine);
+        }
+    }
+    m_reassemblyTimer->start();
+
+    AssemblerController::State state = m_asmController->state();
+    if (state == AssemblerController::PAUSED || state == AssemblerController::RUNNING
+            || state == AssemblerController::FINISHED)
+        m_asmController->reset();
+}
+
+/**
+ * Hands the pending edits to the assembler as a single one; the translation
+ * commands do so first, so that they never run on an outdated source.
+ */
+void HackAssemblerEditor::flushSourceEdits()
+{
+    m_reassemblyTimer->stop();
+    QTextDocument *document = ui->sourceTextEdit->document();
+    if (m_pendingWholeSource || (m_pendingFirstLine > -1 && m_pendingOldEnd > m_asmController->sourceLineCount())) {
+        m_asmController->setSourceCode(document->toPlainText());
+    } else if (m_pendingFirstLine > -1) {
+        QStringList lines;
+        lines.reserve(m_pendingNewEnd - m_pendingFirstLine);
+        QTextBlock block = document->findBlockByNumber(m_pendingFirstLine);
+        for (int line = m_pendingFirstLine; line < m_pendingNewEnd; line++, block = block.next())
+            lines << block.text();
+        m_asmController->replaceSourceLines(m_pendingFirstLine, m_pendingOldEnd - m_pendingFirstLine, lines);
+    }
+    m_pendingFirstLine = -1;
+    m_pendingWholeSource = false;
+}
+
 void HackAssemblerEditor::on_sourceTextEdit_textChanged()
 {
     setWindowModified(ui->sourceTextEdit->document()->isModified());
-    m_asmController->setSourceCode(ui->sourceTextEdit->toPlainText());
+}
 
-    const Assembler::ErrorList& errors = m_asmController->errors();
-    ui->errorList->clear();
-    ui->errorButton->setEnabled(!errors.empty());
+/**
+ * The error messages are taken from the document, which matches the
+ * assembled source unless more edits are pending; their own assembly will
+ * follow then. The current line is only refreshed when the errors changed.
+ */
+void HackAssemblerEditor::asmControllerAssembled()
+{
+    if (m_pendingWholeSource || m_pendingFirstLine > -1)
+        return;
 
-    cursorPositionChanged();
+    const Assembler::ErrorList& errors = m_asmController->errors();
+    if (m_errorListModel->setErrors(errors)) {
+        ui->errorButton->setEnabled(!errors.empty());
+        if (errors.empty())
+            ui->errorButton->setChecked(false);
 
-    if (errors.empty()) {
-        ui->errorButton->setChecked(false);
-    } else {
-        for (const Assembler::Error& error : m_asmController->errors()) {
-            QString formattedLine = QString::number(error.line + 1).rightJustified(3, ' ');
-            ui->errorList->addItem(QString("%1: %2").arg(formattedLine).arg(error.message));
-        }
+        cursorPositionChanged();
     }
+
+    if (m_pendingEmulatorCommand != NO_EMULATOR_COMMAND)
+        startEmulation(m_pendingEmulatorCommand);
 }
 
 void HackAssemblerEditor::asmControllerStateChanged(AssemblerController::State newState)
 {
     switch (newState) {
     case AssemblerController::NO_SOURCE:
-        ui->translatedCode->clear();
+        m_translatedCodeModel->clear();
+        ui->rateLabel->clear();
         ui->runPauseButton->setChecked(false);
         ui->runPauseButton->setEnabled(false);
         ui->nextButton->setEnabled(false);
@@ -291,7 +539,8 @@ void HackAssemblerEditor::asmControllerStateChanged(AssemblerController::State n
         break;
 
     case AssemblerController::RESET:
-        ui->translatedCode->clear();
+        m_translatedCodeModel->clear();
+        ui->rateLabel->clear();
         ui->runPauseButton->setChecked(false);
         ui->runPauseButton->setEnabled(true);
         ui->nextButton->setEnabled(true);
@@ -305,11 +554,10 @@ void HackAssemblerEditor::asmControllerStateChanged(AssemblerController::State n
         ui->resetButton->setEnabled(true);
 
         // FINISHED after RESET: translate all command.
-        if (ui->translatedCode->count() == 0) {
-            for (const QString &line : m_asmController->binaryCode())
-                addLineToListWidget(ui->translatedCode, line);
+        if (m_translatedCodeModel->lineCount() == 0) {
+            m_translatedCodeModel->setTranslatedCode(m_asmController->binaryCode(), m_asmController->translatedLineCount());
             int selectedSourceLine = ui->sourceTextEdit->textCursor().blockNumber();
-            ui->translatedCode->setCurrentRow(m_asmController->binaryLineForSourceLine(selectedSourceLine));
+            setCurrentTranslatedLine(m_asmController->binaryLineForSourceLine(selectedSourceLine));
         }
         break;
 
@@ -332,30 +580,95 @@ void HackAssemblerEditor::asmControllerStateChanged(AssemblerController::State n
     ui->action_ResetTranslation->setEnabled(ui->resetButton->isEnabled());
 }
 
+/**
+ * At turbo speeds line is the last of a batch; the selected source line
+ * may be anywhere in it.
+ */
 void HackAssemblerEditor::asmControllerCurrentLineChanged(int line)
 {
-    addLineToListWidget(ui->translatedCode, m_asmController->binaryCode().at(line));
+    int firstLine = m_translatedCodeModel->lineCount();
+    m_translatedCodeModel->setTranslatedCode(m_asmController->binaryCode(), line + 1);
     int selectedSourceLine = ui->sourceTextEdit->textCursor().blockNumber();
-    if (selectedSourceLine == m_asmController->sourceLineForBinaryLine(line))
-        ui->translatedCode->setCurrentRow(line);
+    int selectedLine = m_asmController->binaryLineForSourceLine(selectedSourceLine);
+    if (selectedLine >= firstLine && selectedLine <= line)
+        setCurrentTranslatedLine(selectedLine);
+}
+
+void HackAssemblerEditor::asmControllerTranslationRateChanged(int linesPerSecond)
+{
+    ui->rateLabel->setText(tr("%L1 lines/s").arg(linesPerSecond));
+}
+
+/**
+ * Shown as published, once per frame at most; while the emulator is idle,
+ * the translated code follows its PC when it moves.
+ */
+void HackAssemblerEditor::emulatorUpdated()
+{
+    const EmulatorSnapshot& snapshot = m_emulatorController->snapshot();
+
+    QString status;
+    if (m_emulatorController->isRunning())
+        status = tr("Running");
+    else if (snapshot.stopReason == HackCpu::HALTED)
+        status = tr("Halted");
+    else if (snapshot.stopReason == HackCpu::BREAKPOINT)
+        status = tr("Breakpoint");
+    else if (snapshot.stopReason == HackCpu::WATCHPOINT)
+        status = tr("Wrote RAM[%1]").arg(snapshot.watchpointAddress);
+    else
+        status = tr("Paused");
+    ui->registersLabel->setText(tr("%1\nPC %2\nA  %3\nD  %4\n%L5 instructions")
+                                .arg(status).arg(snapshot.pc).arg(snapshot.a).arg(qint16(snapshot.d))
+                                .arg(snapshot.instructionCount));
+
+    QStringList ram;
+    for (const EmulatorSnapshot::RamWindow& window : snapshot.ramWindows) {
+        if (!ram.isEmpty())
+            ram << QString();
+        for (int i = 0; i < EmulatorSnapshot::RAM_WINDOW_SIZE; i++)
+            ram << QString("%1 %2").arg(window.first + i, 5).arg(qint16(window.words[i]), 6);
+    }
+    ui->ramLabel->setText(ram.join("\n"));
+
+    if (!m_emulatorController->isRunning() && m_emulatorController->hasProgram() && snapshot.pc != m_emulatedPc) {
+        m_emulatedPc = snapshot.pc;
+        setCurrentTranslatedLine(m_emulatedPc);
+    }
+}
+
+void HackAssemblerEditor::emulatorRunningChanged(bool running)
+{
+    ui->action_RunPauseEmulation->setChecked(running);
+    if (!running)
+        ui->emulatorDock->setWindowTitle(tr("Emulator"));
+}
+
+void HackAssemblerEditor::emulatorInstructionRateChanged(qint64 instructionsPerSecond)
+{
+    ui->emulatorDock->setWindowTitle(tr("Emulator, %L1 instructions/s").arg(instructionsPerSecond));
 }
 
 void HackAssemblerEditor::translatedCodeModelChanged(const QModelIndex &parent, int first, int last)
 {
     Q_UNUSED(parent);
     Q_UNUSED(first);
+    Q_UNUSED(last);
     ui->action_SaveTranslatedBinary->setEnabled(true);
     ui->saveHackBinaryButton->setEnabled(true);
     ui->copyTranslatedButton->setEnabled(true);
-    updateBinDiffLine(last);
+    m_referenceCodeModel->setTranslatedCode(m_translatedCodeModel->code(), m_translatedCodeModel->lineCount());
+    updateMismatchActions();
 }
 
 void HackAssemblerEditor::translatedCodeModelReset()
 {
-    ui->action_SaveTranslatedBinary->setEnabled(false);
-    ui->saveHackBinaryButton->setEnabled(false);
-    ui->copyTranslatedButton->setEnabled(false);
-    clearReferenceCodeBinDiff();
+    bool hasTranslatedCode = m_translatedCodeModel->lineCount() > 0;
+    ui->action_SaveTranslatedBinary->setEnabled(hasTranslatedCode);
+    ui->saveHackBinaryButton->setEnabled(hasTranslatedCode);
+    ui->copyTranslatedButton->setEnabled(hasTranslatedCode);
+    m_referenceCodeModel->setTranslatedCode(m_translatedCodeModel->code(), m_translatedCodeModel->lineCount());
+    updateMismatchActions();
 }
 
 QFileInfo HackAssemblerEditor::openSourceFile(const QString &filename)
@@ -364,12 +677,23 @@ QFileInfo HackAssemblerEditor::openSourceFile(const QString &filename)
     if (!fileInfo.exists())
         return fileInfo;
 
-    QFile file(filename);
-    file.open(QFile::ReadOnly | QFile::Text);
-    QTextStream sourceStream(&file);
+    MappedFile file;
+    if (!file.open(filename)) {
+        QMessageBox::warning(this, tr("Open Hack Assembly source"),
+                             tr("Could not open %1:\n%2").arg(fileInfo.absoluteFilePath(), file.errorString()));
+        return QFileInfo();
+    }
 
-    ui->sourceTextEdit->setPlainText(sourceStream.readAll());
+    // The document reports the new text as an edit of every line; the
+    // assembler gets the loaded text as a whole instead, and any edits
+    // still pending go with the old text.
+    const QString text = file.text();
+    ui->sourceTextEdit->setPlainText(text);
     ui->sourceTextEdit->setDocumentTitle(fileInfo.absoluteFilePath());
+    m_reassemblyTimer->stop();
+    m_pendingFirstLine = -1;
+    m_pendingWholeSource = false;
+    m_asmController->setSourceCode(text);
 
     QGuiApplication::setApplicationDisplayName(fileInfo.fileName());
     setWindowModified(ui->sourceTextEdit->document()->isModified());
@@ -377,88 +701,47 @@ QFileInfo HackAssemblerEditor::openSourceFile(const QString &filename)
     return fileInfo;
 }
 
+/**
+ * The reference file stays mapped while it is shown; its rows are only read
+ * as they are scrolled into view or compared.
+ */
 QFileInfo HackAssemblerEditor::openReferenceBinaryFile(const QString &filename)
 {
-    QFile file(filename);
-    file.open(QFile::ReadOnly | QFile::Text);
-    QTextStream sourceStream(&file);
-    ui->referenceCode->clear();
-    for (const QString &line : sourceStream.readAll().split("\n")) {
-        if (line.trimmed().isEmpty())
-            continue;
-        addLineToListWidget(ui->referenceCode, line);
-    }
-    ui->copyReferenceButton->setEnabled(ui->referenceCode->count() > 0);
+    m_referenceCodeModel->open(filename);
+    ui->copyReferenceButton->setEnabled(m_referenceCodeModel->lineCount() > 0);
+    updateMismatchActions();
     return QFileInfo(filename);
 }
 
-void HackAssemblerEditor::addLineToListWidget(QListWidget *listWidget, QString line)
+QVector<quint16> HackAssemblerEditor::translatedBinaryCode() const
 {
-    listWidget->addItem(line.insert(12, ' ').insert(8, ' ').insert(4, ' '));
+    return m_asmController->binaryCode().mid(0, m_asmController->translatedLineCount());
 }
 
-void HackAssemblerEditor::copyListWidgetContentsToClipboard(const QListWidget *listWidget)
+void HackAssemblerEditor::on_translatedCode_activated(const QModelIndex& index)
 {
-    QStringList binaryCode;
-    for (int i = 0; i < listWidget->count(); i++)
-        binaryCode << listWidget->item(i)->text().replace(" ", "");
-    QApplication::clipboard()->setText(binaryCode.join("\n"));
-}
-
-void HackAssemblerEditor::updateBinDiff()
-{
-    for (int line = 0; line < ui->translatedCode->count(); line++)
-        updateBinDiffLine(line);
-}
-
-void HackAssemblerEditor::updateBinDiffLine(int line)
-{
-    QListWidgetItem* translatedLineItem = ui->translatedCode->item(line);
-    Qt::GlobalColor lineColor(Qt::darkGreen);
-
-    QListWidgetItem* referenceLineItem = NULL;
-    if (line < ui->referenceCode->count())
-         referenceLineItem = ui->referenceCode->item(line);
-
-    if (!referenceLineItem)
-        lineColor = Qt::darkGray;
-    else if (translatedLineItem->text() != referenceLineItem->text())
-        lineColor = Qt::red;
-
-    translatedLineItem->setTextColor(lineColor);
-    if (referenceLineItem)
-        referenceLineItem->setTextColor(lineColor);
-}
-
-void HackAssemblerEditor::clearReferenceCodeBinDiff()
-{
-    for (int line = 0; line < ui->referenceCode->count(); line++) {
-        QListWidgetItem* referenceLineItem = ui->referenceCode->item(line);
-        referenceLineItem->setTextColor(Qt::black);
-    }
-}
-
-void HackAssemblerEditor::on_translatedCode_itemActivated(QListWidgetItem *item)
-{
-    Q_UNUSED(item);
+    Q_UNUSED(index);
     ui->sourceTextEdit->setFocus();
 }
 
-void HackAssemblerEditor::on_translatedCode_currentRowChanged(int currentRow)
+void HackAssemblerEditor::translatedCodeCurrentChanged(const QModelIndex& current)
 {
-    int newRow = currentRow < ui->referenceCode->count() ? currentRow : -1;
-    if (newRow != ui->referenceCode->currentRow())
-        ui->referenceCode->setCurrentRow(newRow);
+    int currentRow = current.row();
+    int newRow = currentRow < m_referenceCodeModel->rowCount() ? currentRow : -1;
+    if (newRow != ui->referenceCode->currentIndex().row())
+        ui->referenceCode->setCurrentIndex(m_referenceCodeModel->index(newRow));
 
-    int sourceLine = m_asmController->sourceLineForBinaryLine(ui->translatedCode->currentRow());
+    int sourceLine = m_asmController->sourceLineForBinaryLine(m_translatedCodeModel->lineForRow(currentRow));
     if (sourceLine > -1)
         goToSourceLine(sourceLine);
 }
 
-void HackAssemblerEditor::on_referenceCode_currentRowChanged(int currentRow)
+void HackAssemblerEditor::referenceCodeCurrentChanged(const QModelIndex& current)
 {
-    if (currentRow > -1 && currentRow < ui->translatedCode->count())
-        ui->translatedCode->setCurrentRow(currentRow );
+    int currentRow = current.row();
+    if (currentRow > -1 && currentRow < m_translatedCodeModel->rowCount()
+            && currentRow != ui->translatedCode->currentIndex().row())
+        ui->translatedCode->setCurrentIndex(m_translatedCodeModel->index(currentRow));
 }
 
 void HackAssemblerEditor::translatedCodeScrollMoved(int value)
@@ -475,12 +758,16 @@ void HackAssemblerEditor::referenceCodeScrollMoved(int value)
 
 void HackAssemblerEditor::on_copyTranslatedButton_clicked()
 {
-    copyListWidgetContentsToClipboard(ui->translatedCode);
+    QApplication::clipboard()->setText(QString::fromLatin1(Code::hackFileContents(translatedBinaryCode()).trimmed()));
 }
 
 void HackAssemblerEditor::on_copyReferenceButton_clicked()
 {
-    copyListWidgetContentsToClipboard(ui->referenceCode);
+    QStringList binaryCode;
+    binaryCode.reserve(m_referenceCodeModel->lineCount());
+    for (int line = 0; line < m_referenceCodeModel->lineCount(); line++)
+        binaryCode << m_referenceCodeModel->lineText(line);
+    QApplication::clipboard()->setText(binaryCode.join("\n"));
 }
 
 bool HackAssemblerEditor::handleSourceSaving()
@@ -554,3 +841,77 @@ void HackAssemblerEditor::goToSourceLine(int sourceLine)
     cursor.movePosition(QTextCursor::EndOfLine);
     ui->sourceTextEdit->setTextCursor(cursor);
 }
+
+/**
+ * -1, like any line that has not been translated, clears the current line.
+ */
+void HackAssemblerEditor::setCurrentTranslatedLine(int line)
+{
+    ui->translatedCode->setCurrentIndex(m_translatedCodeModel->index(m_translatedCodeModel->rowForLine(line)));
+}
+
+/**
+ * Edits are handed to the assembler first. Until the worker has assembled
+ * them, the errors and binary code are those of the previous source, so the
+ * command waits for asmControllerAssembled().
+ */
+void HackAssemblerEditor::startEmulation(EmulatorCommand command)
+{
+    flushSourceEdits();
+    if (!m_asmController->isAssembled()) {
+        m_pendingEmulatorCommand = command;
+        return;
+    }
+    m_pendingEmulatorCommand = NO_EMULATOR_COMMAND;
+
+    if (!loadEmulatorProgram())
+        ui->action_RunPauseEmulation->setChecked(false);
+    else if (command == EMULATOR_RUN)
+        m_emulatorController->run();
+    else
+        m_emulatorController->step();
+}
+
+/**
+ * The emulator runs the whole translation of the latest assembled source,
+ * which it shows all of. It starts over whenever that has changed since
+ * it was loaded, and not at all while it has errors.
+ */
+bool HackAssemblerEditor::loadEmulatorProgram()
+{
+    if (m_asmController->state() == AssemblerController::NO_SOURCE || !m_asmController->errors().isEmpty()) {
+        ui->registersLabel->setText(tr("Nothing to run without errors"));
+        return false;
+    }
+    if (m_asmController->state() != AssemblerController::FINISHED)
+        on_action_TranslateAll_triggered();
+
+    if (!m_emulatorController->hasProgram() || m_asmController->binaryCode() != m_emulatedCode) {
+        m_emulatedCode = m_asmController->binaryCode();
+        m_emulatorController->loadProgram(m_emulatedCode);
+        m_emulatedPc = -1;
+    }
+    return true;
+}
+
+void HackAssemblerEditor::updateBreakpointsLabel()
+{
+    QList<int> breakpoints = m_emulatorController->breakpoints().values();
+    QList<int> watchpoints = m_emulatorController->watchpoints().values();
+    std::sort(breakpoints.begin(), breakpoints.end());
+    std::sort(watchpoints.begin(), watchpoints.end());
+
+    QStringList lines;
+    for (int address : breakpoints)
+        lines << tr("Break at %1").arg(address);
+    for (int address : watchpoints)
+        lines << tr("Watch RAM[%1]").arg(address);
+    ui->breakpointsLabel->setText(lines.isEmpty() ? tr("No breakpoints") : lines.join("\n"));
+}
+
+void HackAssemblerEditor::updateMismatchActions()
+{
+    bool hasMismatches = m_referenceCodeModel->mismatchCount() > 0;
+    ui->action_NextMismatch->setEnabled(hasMismatches);
+    ui->action_PreviousMismatch->setEnabled(hasMismatches);
+}
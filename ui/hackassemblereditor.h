@@ -2,12 +2,16 @@
 #define HACKASSEMBLEREDITOR_H
 
 #include <QFileInfo>
-#include <QListWidget>
+#include <QLabel>
 #include <QMainWindow>
 
 #include "aboutdialog.h"
 #include "helpers/assemblercontroller.h"
+#include "helpers/emulatorcontroller.h"
+#include "helpers/errorlistmodel.h"
 #include "helpers/hacksyntaxhighlighter.h"
+#include "helpers/referencecodemodel.h"
+#include "helpers/translatedcodemodel.h"
 
 namespace Ui {
 class MainWindow;
@@ -41,24 +45,43 @@ private slots:
     void on_action_StepTranslation_triggered();
     void on_action_ResetTranslation_triggered();
     void on_action_TranslateAll_triggered();
+    void on_action_NextMismatch_triggered();
+    void on_action_PreviousMismatch_triggered();
+    void on_action_AlignDiff_toggled(bool checked);
+    void on_action_ReassemblyDelay_triggered();
+
+    void on_action_RunPauseEmulation_triggered(bool checked);
+    void on_action_StepEmulation_triggered();
+    void on_action_ResetEmulation_triggered();
+    void on_action_ToggleBreakpoint_triggered();
+    void on_action_ToggleWatchpoint_triggered();
+    void on_ramWindowSpinBox_valueChanged(int value);
 
     void on_speedSlider_valueChanged(int value);
     void on_errorButton_toggled(bool checked);
-    void on_errorList_currentRowChanged(int currentRow);
-    void on_errorList_itemActivated(QListWidgetItem *item);
+    void errorListCurrentChanged(const QModelIndex& current);
+    void on_errorList_activated(const QModelIndex& index);
 
     void on_sourceTextEdit_textChanged();
+    void sourceContentsChange(int position, int charsRemoved, int charsAdded);
+    void flushSourceEdits();
 
     void asmControllerStateChanged(AssemblerController::State newState);
     void asmControllerCurrentLineChanged(int line);
+    void asmControllerTranslationRateChanged(int linesPerSecond);
+    void asmControllerAssembled();
+
+    void emulatorUpdated();
+    void emulatorRunningChanged(bool running);
+    void emulatorInstructionRateChanged(qint64 instructionsPerSecond);
 
     void translatedCodeModelChanged(const QModelIndex &parent, int first, int last);
     void translatedCodeModelReset();
 
-    void on_translatedCode_itemActivated(QListWidgetItem *item);
+    void on_translatedCode_activated(const QModelIndex& index);
 
-    void on_translatedCode_currentRowChanged(int currentRow);
-    void on_referenceCode_currentRowChanged(int currentRow);
+    void translatedCodeCurrentChanged(const QModelIndex& current);
+    void referenceCodeCurrentChanged(const QModelIndex& current);
 
     void translatedCodeScrollMoved(int value);
     void referenceCodeScrollMoved(int value);
@@ -69,29 +92,59 @@ private slots:
     void cursorPositionChanged();
 
 private:
+    enum EmulatorCommand {
+        NO_EMULATOR_COMMAND,
+        EMULATOR_RUN,
+        EMULATOR_STEP
+    };
+
     QFileInfo openSourceFile(const QString &filename);
     QFileInfo openReferenceBinaryFile(const QString &filename);
 
-    void addLineToListWidget(QListWidget *listWidget, QString line);
-    void copyListWidgetContentsToClipboard(const QListWidget *listWidget);
-
-    void updateBinDiff();
-    void updateBinDiffLine(int line);
-    void clearReferenceCodeBinDiff();
+    QVector<quint16> translatedBinaryCode() const;
 
     bool handleSourceSaving();
     bool saveSourceAs();
     bool saveSource(const QString& filename);
 
     void goToSourceLine(int sourceLine);
+    void setCurrentTranslatedLine(int line);
+    void updateMismatchActions();
+    void startEmulation(EmulatorCommand command);
+    bool loadEmulatorProgram();
+    void updateBreakpointsLabel();
 
     static const int DEFAULT_SPEED;
+    static const int DEFAULT_REASSEMBLY_DELAY;
+    static const int MAX_REASSEMBLY_DELAY;
 
     Ui::MainWindow *ui;
     AboutDialog *m_about;
 
     AssemblerController* m_asmController;
+    EmulatorController *m_emulatorController;
+    // The program last loaded into the emulator, and the PC last shown.
+    QVector<quint16> m_emulatedCode;
+    int m_emulatedPc;
+    // Run or step asked for before the latest edits were assembled.
+    EmulatorCommand m_pendingEmulatorCommand;
+    int m_sourceLineCount;
+    // Source edits not handed to the assembler yet, merged into one range:
+    // it starts at the same line before and after them, and ends at
+    // m_pendingOldEnd before and m_pendingNewEnd after them.
+    QTimer *m_reassemblyTimer;
+    int m_pendingFirstLine;
+    int m_pendingOldEnd;
+    int m_pendingNewEnd;
+    bool m_pendingWholeSource;
+    // Edits merged into one already waiting to be assembled, so that their
+    // own reassembly was skipped; shown in the status bar.
+    int m_coalescedEditCount;
+    QLabel *m_coalescedEditsLabel;
     HackSyntaxHighlighter *m_hackSyntaxHighlighter;
+    ErrorListModel *m_errorListModel;
+    ReferenceCodeModel *m_referenceCodeModel;
+    TranslatedCodeModel *m_translatedCodeModel;
 };
 
 #endif // HACKASSEMBLEREDITOR_H